@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include "Interner.h"
+using namespace std;
+
+// Bump allocator. Allocation is a pointer increment inside the current block;
+// nothing is freed individually, every block is released when the arena dies.
+// Only trivially destructible objects may live in it.
+class Arena
+{
+public:
+    explicit Arena(size_t blockSize = 64 * 1024) : blockSize(blockSize) {}
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    ~Arena()
+    {
+        for (char *block : blocks)
+            free(block);
+    }
+
+    void *allocate(size_t size, size_t align = alignof(max_align_t))
+    {
+        size_t offset = (used + align - 1) & ~(align - 1);
+        if (blocks.empty() || offset + size > capacity)
+        {
+            capacity = size > blockSize ? size : blockSize;
+            char *block = (char *)malloc(capacity);
+            if (!block)
+                throw bad_alloc();
+            blocks.push_back(block);
+            reserved += capacity;
+            offset = 0;
+        }
+        used = offset + size;
+        return blocks.back() + offset;
+    }
+
+    template <typename T>
+    T *allocateArray(size_t count)
+    {
+        return (T *)allocate(sizeof(T) * count, alignof(T));
+    }
+
+    size_t bytesReserved() const
+    {
+        return reserved;
+    }
+
+private:
+    size_t blockSize;
+    vector<char *> blocks;
+    size_t used = 0;
+    size_t capacity = 0;
+    size_t reserved = 0;
+};
+
+typedef uint32_t NodeId;
+const NodeId NoNode = 0xFFFFFFFFu;
+
+enum NodeKind : uint8_t
+{
+    // Expressions
+    N_NUMBER, // a: literal text
+    N_STRING, // a: decoded value
+    N_BOOL,   // a: "true" / "false"
+    N_NAME,   // a: variable or member path ("r.length")
+    N_BINARY, // op: operator token, a: left, b: right
+
+    // Statements. Statement lists are chained through Node::next.
+    N_DECLARATION, // op: type token, a: name, b: initializer or NoNode
+    N_ASSIGN,      // a: target path, b: value
+    N_IF,          // a: condition, b: then, c: else or NoNode
+    N_WHILE,       // a: condition, b: body
+    N_FOR,         // a: init statement, b: condition, c: increment (N_ASSIGN), d: body
+    N_SWITCH,      // a: value, b: first case
+    N_CASE,        // a: case value text, b: statement
+    N_DEFAULT,     // b: statement
+    N_FUNC,        // a: name, b: first statement
+    N_RETURN,      // a: value
+    N_BREAK,
+    N_BLOCK,  // a: first statement
+    N_STRUCT, // a: name, b: first member declaration
+    N_CLASS,  // a: name, b: first member declaration
+    N_EMPTY
+};
+
+// One AST node: a kind tag and four 32-bit operands whose meaning depends on the
+// kind (see NodeKind). Names and literal texts are interned symbol ids; children
+// are node ids. 24 bytes, so a cache line holds two and a half nodes.
+struct Node
+{
+    NodeKind kind;
+    uint8_t op; // TokenType of the operator or declared type
+    uint16_t unused;
+    uint32_t a, b, c, d;
+    NodeId next; // next statement or case in the same list
+};
+static_assert(sizeof(Node) == 24, "AST nodes should stay 24 bytes");
+
+// The tree for one compilation. Nodes live in fixed-size chunks carved out of an
+// arena and are addressed by index; the whole tree is freed at once with the Ast.
+class Ast
+{
+public:
+    NodeId root = NoNode; // first top-level statement
+
+    NodeId add(NodeKind kind, uint32_t a = NoNode, uint32_t b = NoNode, uint32_t c = NoNode, uint32_t d = NoNode)
+    {
+        if ((count & ChunkMask) == 0)
+            chunks.push_back(arena.allocateArray<Node>(ChunkSize));
+        NodeId id = count++;
+        Node &node = (*this)[id];
+        node.kind = kind;
+        node.op = 0;
+        node.unused = 0;
+        node.a = a;
+        node.b = b;
+        node.c = c;
+        node.d = d;
+        node.next = NoNode;
+        return id;
+    }
+
+    Node &operator[](NodeId id)
+    {
+        return chunks[id >> ChunkBits][id & ChunkMask];
+    }
+
+    const Node &operator[](NodeId id) const
+    {
+        return chunks[id >> ChunkBits][id & ChunkMask];
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    size_t bytesReserved() const
+    {
+        return arena.bytesReserved();
+    }
+
+private:
+    static const uint32_t ChunkBits = 11; // 2048 nodes, 48 KB per chunk
+    static const uint32_t ChunkSize = 1u << ChunkBits;
+    static const uint32_t ChunkMask = ChunkSize - 1;
+
+    Arena arena;
+    vector<Node *> chunks;
+    uint32_t count = 0;
+};
+
+// Appends statements to a Node::next chain
+class NodeListBuilder
+{
+public:
+    explicit NodeListBuilder(Ast &ast) : ast(ast) {}
+
+    void append(NodeId node)
+    {
+        if (last == NoNode)
+            first = node;
+        else
+            ast[last].next = node;
+        last = node;
+    }
+
+    NodeId head() const
+    {
+        return first;
+    }
+
+private:
+    Ast &ast;
+    NodeId first = NoNode;
+    NodeId last = NoNode;
+};
@@ -0,0 +1,610 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+#include <map>
+#include "Compiler.h"
+#include "Lexer.h"
+#include "ParallelLexer.h"
+using namespace std;
+
+// Heap traffic counters, used to compare token storage strategies
+static size_t allocationCount = 0;
+static size_t allocatedBytes = 0;
+
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    allocationCount++;
+    allocatedBytes += size;
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+// Token layout used before tokens became views into the source buffer
+struct LegacyToken
+{
+    TokenType type;
+    string value;
+    int lineNumber;
+};
+
+// The original sequential keyword comparison chain
+TokenType legacyIdentifyKeyword(string_view word)
+{
+    if (word == "int")
+        return T_INT;
+    else if (word == "if")
+        return T_IF;
+    else if (word == "else")
+        return T_ELSE;
+    else if (word == "return")
+        return T_RETURN;
+    else if (word == "while")
+        return T_WHILE;
+    else if (word == "func")
+        return T_FUNC;
+    else if (word == "switch")
+        return T_SWITCH;
+    else if (word == "case")
+        return T_CASE;
+    else if (word == "default")
+        return T_DEFAULT;
+    else if (word == "bool")
+        return T_BOOL;
+    else if (word == "true")
+        return T_TRUE;
+    else if (word == "false")
+        return T_FALSE;
+    else if (word == "for")
+        return T_FOR;
+    else if (word == "struct")
+        return T_STRUCT;
+    else if (word == "class")
+        return T_CLASS;
+    else if (word == "array")
+        return T_ARRAY;
+    else if (word == "string")
+        return T_STRING_TYPE;
+    return T_ID;
+}
+
+// Reference copy of the original if/switch lexer, kept only so the current lexer
+// can be checked and timed against it.
+class LegacyLexer
+{
+private:
+    string src;
+    size_t pos;
+    int lineNumber;
+
+public:
+    LegacyLexer(const string &src) : src(src), pos(0), lineNumber(1) {}
+
+    vector<LegacyToken> tokenize()
+    {
+        vector<LegacyToken> tokens;
+        while (pos < src.size())
+        {
+            char current = src[pos];
+            if (current == '\n')
+            {
+                lineNumber++;
+                pos++;
+                continue;
+            }
+            if (isspace(current))
+            {
+                pos++;
+                continue;
+            }
+            if (isdigit(current))
+            {
+                tokens.push_back(LegacyToken{T_NUM, consumeNumber(), lineNumber});
+                continue;
+            }
+            if (isalpha(current) || current == '_')
+            {
+                string word = consumeWord();
+                TokenType type = identifyKeyword(word);
+                tokens.push_back(LegacyToken{type, word, lineNumber});
+                continue;
+            }
+            if (current == '"')
+            {
+                tokens.push_back(LegacyToken{T_STRING, consumeString(), lineNumber});
+                continue;
+            }
+            switch (current)
+            {
+            case '=':
+                if (pos + 1 < src.size() && src[pos + 1] == '=')
+                {
+                    tokens.push_back(LegacyToken{T_EQ, "==", lineNumber});
+                    pos++;
+                }
+                else
+                    tokens.push_back(LegacyToken{T_ASSIGN, "=", lineNumber});
+                break;
+            case '!':
+                if (pos + 1 < src.size() && src[pos + 1] == '=')
+                {
+                    tokens.push_back(LegacyToken{T_NEQ, "!=", lineNumber});
+                    pos++;
+                }
+                else
+                    tokens.push_back(LegacyToken{T_ASSIGN, "!", lineNumber});
+                break;
+            case '+':
+                tokens.push_back(LegacyToken{T_PLUS, "+", lineNumber});
+                break;
+            case '-':
+                tokens.push_back(LegacyToken{T_MINUS, "-", lineNumber});
+                break;
+            case '*':
+                tokens.push_back(LegacyToken{T_MUL, "*", lineNumber});
+                break;
+            case '/':
+                tokens.push_back(LegacyToken{T_DIV, "/", lineNumber});
+                break;
+            case '(':
+                tokens.push_back(LegacyToken{T_LPAREN, "(", lineNumber});
+                break;
+            case ')':
+                tokens.push_back(LegacyToken{T_RPAREN, ")", lineNumber});
+                break;
+            case '{':
+                tokens.push_back(LegacyToken{T_LBRACE, "{", lineNumber});
+                break;
+            case '}':
+                tokens.push_back(LegacyToken{T_RBRACE, "}", lineNumber});
+                break;
+            case ';':
+                tokens.push_back(LegacyToken{T_SEMICOLON, ";", lineNumber});
+                break;
+            case '>':
+                if (pos + 1 < src.size() && src[pos + 1] == '=')
+                {
+                    tokens.push_back(LegacyToken{T_GTE, ">=", lineNumber});
+                    pos++;
+                }
+                else
+                    tokens.push_back(LegacyToken{T_GT, ">", lineNumber});
+                break;
+            case '<':
+                if (pos + 1 < src.size() && src[pos + 1] == '=')
+                {
+                    tokens.push_back(LegacyToken{T_LTE, "<=", lineNumber});
+                    pos++;
+                }
+                else
+                    tokens.push_back(LegacyToken{T_LT, "<", lineNumber});
+                break;
+            case ':':
+                tokens.push_back(LegacyToken{T_COLON, ":", lineNumber});
+                break;
+            case '[':
+                tokens.push_back(LegacyToken{T_LBRACKET, "[", lineNumber});
+                break;
+            case ']':
+                tokens.push_back(LegacyToken{T_RBRACKET, "]", lineNumber});
+                break;
+            case '.':
+                tokens.push_back(LegacyToken{T_DOT, ".", lineNumber});
+                break;
+            default:
+                cout << "Lexical error at line " << lineNumber << ": Unexpected character" << endl;
+                exit(1);
+            }
+            pos++;
+        }
+        tokens.push_back(LegacyToken{T_EOF, "", lineNumber});
+        return tokens;
+    }
+
+private:
+    string consumeNumber()
+    {
+        size_t start = pos;
+        while (pos < src.size() && isdigit(src[pos]))
+            pos++;
+        return src.substr(start, pos - start);
+    }
+
+    string consumeWord()
+    {
+        size_t start = pos;
+        while (pos < src.size() && (isalnum(src[pos]) || src[pos] == '_'))
+            pos++;
+        return src.substr(start, pos - start);
+    }
+
+    string consumeString()
+    {
+        pos++;
+        string str = "";
+        while (pos < src.size() && src[pos] != '"')
+        {
+            if (src[pos] == '\\' && pos + 1 < src.size())
+            {
+                pos++;
+                char escape = src[pos];
+                switch (escape)
+                {
+                case 'n':
+                    str += '\n';
+                    break;
+                case 't':
+                    str += '\t';
+                    break;
+                default:
+                    str += escape;
+                    break;
+                }
+            }
+            else
+                str += src[pos];
+            pos++;
+        }
+        pos++;
+        return str;
+    }
+
+    TokenType identifyKeyword(const string &word)
+    {
+        return legacyIdentifyKeyword(word);
+    }
+};
+
+// Builds roughly `bytes` of source by repeating a snippet that touches every token kind
+string makeLexerInput(size_t bytes)
+{
+    const string snippet = R"(
+int counter_1 = 10;
+accumulated_total_value = accumulated_total_value + counter_1;
+string label = "tab\tand \"quote\"";
+bool done = false;
+while (counter_1 >= 0) {
+    if (counter_1 == 5) { done = true; } else { counter_1 = counter_1 - 1; }
+    result = (a * b + 10) / 2;
+    flag = x != y; check = x <= y; r.length = arr[3];
+}
+switch (state) { case 15: state = state * 2; default: state = 0; }
+)";
+    string out;
+    out.reserve(bytes + snippet.size());
+    while (out.size() < bytes)
+        out += snippet;
+    return out;
+}
+
+template <typename Fn>
+double bestSeconds(int runs, Fn fn)
+{
+    double best = 1e30;
+    for (int i = 0; i < runs; i++)
+    {
+        auto start = chrono::steady_clock::now();
+        fn();
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        if (elapsed.count() < best)
+            best = elapsed.count();
+    }
+    return best;
+}
+
+void benchmarkLexer(size_t bytes, int runs)
+{
+    string text = makeLexerInput(bytes);
+    double mb = text.size() / (1024.0 * 1024.0);
+    SourceBuffer source(text);
+
+    vector<LegacyToken> legacyTokens = LegacyLexer(text).tokenize();
+    vector<Token> tokens = Lexer(source).tokenize();
+    if (legacyTokens.size() != tokens.size())
+    {
+        cout << "Token count mismatch: legacy " << legacyTokens.size() << ", current " << tokens.size() << endl;
+        exit(1);
+    }
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+        if (legacyTokens[i].type != tokens[i].type || legacyTokens[i].value != tokens[i].value ||
+            legacyTokens[i].lineNumber != tokens[i].lineNumber)
+        {
+            cout << "Token mismatch at index " << i << " (line " << tokens[i].lineNumber << ")" << endl;
+            exit(1);
+        }
+    }
+
+    double legacy = bestSeconds(runs, [&]
+                                { LegacyLexer(text).tokenize(); });
+    double current = bestSeconds(runs, [&]
+                                 { Lexer(source).tokenize(); });
+
+    cout << "Lexer (" << mb << " MB, " << tokens.size() << " tokens, best of " << runs
+         << ", " << lexscan::kernels.name << " scan kernels)" << endl;
+    cout << "  legacy if/switch : " << legacy * 1000 << " ms, " << mb / legacy << " MB/s" << endl;
+    cout << "  current lexer    : " << current * 1000 << " ms, " << mb / current << " MB/s" << endl;
+    cout << "  speedup          : " << legacy / current << "x" << endl;
+}
+
+// Parallel tokenization throughput for 1..8 worker threads
+void benchmarkParallelLexer(size_t bytes, int runs)
+{
+    string text = makeLexerInput(bytes);
+    double mb = text.size() / (1024.0 * 1024.0);
+    SourceBuffer source(text);
+
+    vector<Token> expected = Lexer(source).tokenize();
+    vector<Token> actual = tokenizeParallel(source, 8);
+    for (size_t i = 0; i < expected.size() || i < actual.size(); i++)
+    {
+        if (i >= expected.size() || i >= actual.size() || expected[i].type != actual[i].type ||
+            expected[i].value != actual[i].value || expected[i].lineNumber != actual[i].lineNumber ||
+            expected[i].symbol != actual[i].symbol)
+        {
+            cout << "Parallel token mismatch at index " << i << endl;
+            exit(1);
+        }
+    }
+
+    cout << "Parallel lexer (" << mb << " MB, best of " << runs << ", "
+         << thread::hardware_concurrency() << " hardware threads)" << endl;
+    double single = 0;
+    for (unsigned threads = 1; threads <= 8; threads *= 2)
+    {
+        double seconds = bestSeconds(runs, [&]
+                                     { tokenizeParallel(source, threads); });
+        if (threads == 1)
+            single = seconds;
+        cout << "  " << threads << " thread" << (threads == 1 ? " " : "s") << "        : " << seconds * 1000 << " ms, "
+             << mb / seconds << " MB/s, " << single / seconds << "x" << endl;
+    }
+}
+
+// Heap allocations and bytes spent producing the token vector for `lines` lines of source
+void benchmarkTokenMemory(size_t lines)
+{
+    string snippet = makeLexerInput(1);
+    size_t snippetLines = count(snippet.begin(), snippet.end(), '\n');
+    string text;
+    for (size_t n = 0; n < lines; n += snippetLines)
+        text += snippet;
+    SourceBuffer source(text);
+
+    size_t countBefore = allocationCount, bytesBefore = allocatedBytes;
+    size_t legacyTokens = LegacyLexer(text).tokenize().size();
+    size_t legacyAllocs = allocationCount - countBefore, legacyBytes = allocatedBytes - bytesBefore;
+
+    countBefore = allocationCount, bytesBefore = allocatedBytes;
+    size_t viewTokens = Lexer(source).tokenize().size();
+    size_t viewAllocs = allocationCount - countBefore, viewBytes = allocatedBytes - bytesBefore;
+
+    // Pull the same tokens through the bounded-lookahead stream the parser uses
+    countBefore = allocationCount, bytesBefore = allocatedBytes;
+    Lexer streamingLexer(source);
+    TokenStream<Token> stream(streamingLexer);
+    size_t streamedTokens = 1;
+    while (stream.next().type != T_EOF)
+        streamedTokens++;
+    size_t streamAllocs = allocationCount - countBefore, streamBytes = allocatedBytes - bytesBefore;
+
+    cout << "Token storage (" << lines << " lines)" << endl;
+    cout << "  owned strings    : " << legacyTokens << " tokens x " << sizeof(LegacyToken) << " B, "
+         << legacyAllocs << " allocations, " << legacyBytes / 1024 << " KB allocated" << endl;
+    cout << "  source views     : " << viewTokens << " tokens x " << sizeof(Token) << " B, "
+         << viewAllocs << " allocations, " << viewBytes / 1024 << " KB allocated" << endl;
+    cout << "  streamed         : " << streamedTokens << " tokens through a " << sizeof(TokenStream<Token>)
+         << " B ring buffer, " << streamAllocs << " allocations, " << streamBytes / 1024 << " KB allocated" << endl;
+}
+
+// Per-word cost of keyword classification: comparison chain vs perfect hash
+void benchmarkKeywords(int runs)
+{
+    const string_view sample[] = {"int", "counter", "if", "result", "while", "x", "return", "accumulated_total_value",
+                                  "string", "label", "struct", "length", "i", "switch", "state", "default", "flag",
+                                  "temp", "bool", "j", "else", "width", "func", "total", "case", "true", "y"};
+    for (string_view w : sample)
+    {
+        if (legacyIdentifyKeyword(w) != keywordTable.lookup(w))
+        {
+            cout << "Keyword mismatch for '" << w << "'" << endl;
+            exit(1);
+        }
+    }
+
+    // Pseudo-random word order so neither version benefits from a repeating branch pattern
+    vector<string_view> words(1 << 16); // small enough to stay in cache
+    uint32_t state = 12345;
+    size_t keywordCount = 0;
+    for (string_view &w : words)
+    {
+        state = state * 1103515245u + 12345u;
+        w = sample[(state >> 16) % size(sample)];
+        keywordCount += legacyIdentifyKeyword(w) != T_ID;
+    }
+
+    const int passes = 200;
+    volatile int sink = 0;
+    double chain = bestSeconds(runs, [&]
+                               {
+        int acc = 0;
+        for (int p = 0; p < passes; p++)
+            for (string_view w : words)
+                acc += legacyIdentifyKeyword(w);
+        sink = acc; });
+    double hashed = bestSeconds(runs, [&]
+                                {
+        int acc = 0;
+        for (int p = 0; p < passes; p++)
+            for (string_view w : words)
+                acc += keywordTable.lookup(w);
+        sink = acc; });
+    double lookups = double(words.size()) * passes;
+
+    cout << "Keyword classification (" << words.size() << " words, "
+         << keywordCount * 100 / words.size() << "% keywords)" << endl;
+    cout << "  comparison chain : " << chain * 1e9 / lookups << " ns/word" << endl;
+    cout << "  perfect hash     : " << hashed * 1e9 / lookups << " ns/word" << endl;
+}
+
+// Symbol-table lookups for every identifier occurrence: string-keyed map vs interned ids
+void benchmarkSymbolLookup(size_t lines, int runs)
+{
+    string snippet = makeLexerInput(1);
+    size_t snippetLines = count(snippet.begin(), snippet.end(), '\n');
+    string text;
+    for (size_t n = 0; n < lines; n += snippetLines)
+        text += snippet;
+    SourceBuffer source(text);
+
+    vector<Token> identifiers;
+    for (const Token &token : Lexer(source).tokenize())
+        if (token.type == T_ID)
+            identifiers.push_back(token);
+
+    map<string, string> byName;
+    vector<SymbolId> byId(symbols.size(), NoSymbol);
+    SymbolId intType = symbols.intern("int");
+    for (const Token &token : identifiers)
+    {
+        byName[string(token.value)] = "int";
+        byId[token.symbol] = intType;
+    }
+
+    volatile size_t sink = 0;
+    double named = bestSeconds(runs, [&]
+                               {
+        size_t found = 0;
+        for (const Token &token : identifiers)
+            found += byName.find(string(token.value))->second.size();
+        sink = found; });
+    double interned = bestSeconds(runs, [&]
+                                  {
+        size_t found = 0;
+        for (const Token &token : identifiers)
+            found += byId[token.symbol];
+        sink = found; });
+
+    cout << "Symbol lookup (" << identifiers.size() << " identifier occurrences, " << byName.size()
+         << " distinct names)" << endl;
+    cout << "  map<string,string>: " << named * 1e9 / identifiers.size() << " ns/lookup" << endl;
+    cout << "  interned ids      : " << interned * 1e9 / identifiers.size() << " ns/lookup" << endl;
+}
+
+// Dispatch cost of the three switch lowering strategies on the same selectors,
+// each modelled the way its lowered code runs: equality tests in case order, the
+// compare tree lowerCaseSearch emits, and the bounds-checked jump table.
+int linearDispatch(const vector<int64_t> &values, size_t first, size_t last, int64_t x)
+{
+    for (size_t i = first; i < last; i++)
+        if (values[i] == x)
+            return (int)i;
+    return -1;
+}
+
+int searchDispatch(const vector<int64_t> &values, int64_t x)
+{
+    size_t first = 0, last = values.size();
+    while (last - first > SwitchLinearMax)
+    {
+        size_t middle = first + (last - first) / 2;
+        if (x >= values[middle])
+            first = middle;
+        else
+            last = middle;
+    }
+    return linearDispatch(values, first, last, x);
+}
+
+void benchmarkSwitchDispatch(int runs)
+{
+    struct CaseSet
+    {
+        const char *name;
+        vector<int64_t> values; // sorted
+    };
+    vector<CaseSet> sets = {{"small (4 cases)", {}}, {"dense (256 cases)", {}}, {"sparse (256 cases)", {}}};
+    for (int64_t i = 0; i < 4; i++)
+        sets[0].values.push_back(i);
+    for (int64_t i = 0; i < 256; i++)
+    {
+        sets[1].values.push_back(i + (i % 16 == 15)); // a few holes
+        sets[2].values.push_back(i * 37 + i % 5);
+    }
+    static const char *const strategyNames[] = {"linear", "binary search", "jump table"};
+
+    cout << "Switch dispatch (65536 selectors, about 90% matching a case; * = strategy the lowering picks)" << endl;
+    for (CaseSet &set : sets)
+    {
+        const vector<int64_t> &values = set.values;
+        int64_t low = values.front(), high = values.back();
+        vector<int> table(high - low + 1, -1);
+        for (size_t i = 0; i < values.size(); i++)
+            table[values[i] - low] = (int)i;
+
+        vector<int64_t> selectors(1 << 16);
+        uint32_t state = 12345;
+        for (int64_t &x : selectors)
+        {
+            state = state * 1103515245u + 12345u;
+            uint32_t r = state >> 8;
+            x = r % 10 == 0 ? high + 1 + r % 7 : values[r % values.size()];
+        }
+
+        volatile int sink = 0;
+        double seconds[3];
+        seconds[SWITCH_LINEAR] = bestSeconds(runs, [&]
+                                             {
+            int acc = 0;
+            for (int64_t x : selectors)
+                acc += linearDispatch(values, 0, values.size(), x);
+            sink = acc; });
+        seconds[SWITCH_BINARY_SEARCH] = bestSeconds(runs, [&]
+                                                    {
+            int acc = 0;
+            for (int64_t x : selectors)
+                acc += searchDispatch(values, x);
+            sink = acc; });
+        seconds[SWITCH_JUMP_TABLE] = bestSeconds(runs, [&]
+                                                 {
+            int acc = 0;
+            for (int64_t x : selectors)
+                acc += x < low || x > high ? -1 : table[x - low];
+            sink = acc; });
+
+        SwitchStrategy chosen = chooseSwitchStrategy(values.size(), low, high);
+        cout << "  " << left << setw(20) << set.name << right;
+        for (int strategy = 0; strategy < 3; strategy++)
+            cout << "  " << strategyNames[strategy] << (strategy == chosen ? "*" : "") << " "
+                 << fixed << setprecision(2) << seconds[strategy] * 1e9 / selectors.size() << " ns";
+        cout << defaultfloat << endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t megabytes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 16;
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+    benchmarkLexer(megabytes * 1024 * 1024, runs);
+    benchmarkParallelLexer(megabytes * 1024 * 1024, runs);
+    benchmarkTokenMemory(100000);
+    benchmarkKeywords(runs);
+    benchmarkSymbolLookup(100000, runs);
+    benchmarkSwitchDispatch(runs);
+    return 0;
+}
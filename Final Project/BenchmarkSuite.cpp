@@ -0,0 +1,376 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <cstdlib>
+#include "CFG.h"
+#include "Compiler.h"
+#include "Optimizer.h"
+#include "ProgramGenerator.h"
+#include "TimeReport.h"
+#include "X86Backend.h"
+#include "X86Jit.h"
+using namespace std;
+
+// End-to-end benchmark suite for the final project compiler.
+//
+// For each synthetic program shape it takes the best of N runs of every phase.
+// The front end is lexing, parsing and IR lowering. The middle end is control-flow
+// analysis, IR optimization and register allocation. The back end is machine code
+// generation, peephole optimization, x86-64 assembly and JIT encoding into
+// executable memory. The whole streaming pipeline is timed as well, and the
+// numbers can be compared against a stored baseline. Peephole rule hit counts are
+// printed per shape so code size changes can be traced to a rule.
+//
+// Usage: BenchmarkSuite [--units N] [--runs N] [--seed N] [--shape NAME]
+//                       [--baseline FILE] [--save-baseline FILE] [--threshold PCT]
+//        BenchmarkSuite --emit SHAPE UNITS [SEED]
+//        BenchmarkSuite --check
+
+struct Measurement
+{
+    string shape;
+    string phase;
+    double ms;
+};
+
+template <typename Fn>
+double bestMilliseconds(int runs, Fn fn)
+{
+    double best = 1e300;
+    for (int i = 0; i < runs; i++)
+    {
+        auto start = chrono::steady_clock::now();
+        fn();
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+        if (elapsed.count() < best)
+            best = elapsed.count();
+    }
+    return best;
+}
+
+// Times each phase on its own, then the whole streaming pipeline
+vector<Measurement> benchmarkShape(ProgramShape shape, size_t units, uint32_t seed, int runs)
+{
+    string program = ProgramGenerator(seed).generate(shape, units);
+    SourceBuffer source(program);
+    vector<Token> tokens;
+    IntermediateCodeGenerator intermediate;
+    vector<IrInstr> optimized;
+    size_t statements = 0, blocks = 0, loops = 0, removed = 0, machineInstructions = 0, optimizedMachineInstructions = 0, allocations = 0;
+    RegisterAllocation registerAllocation;
+    PeepholeOptimizer peephole;
+    size_t peepholeRemoved = 0, optimizedPeepholeRemoved = 0, assemblyBytes = 0, jitBytes = 0;
+    double lex, parse, lower, cfg, optimize, regalloc, codegen, peepholeMs, assembly, jit, codegenText, endToEnd;
+    lex = bestMilliseconds(runs, [&]
+                           { tokens = Lexer(source).tokenize(); });
+
+    unique_ptr<Ast> ast;
+    parse = bestMilliseconds(runs, [&]
+                             {
+        TokenListSource<Token> list(tokens);
+        TokenStream<Token> stream(list);
+        SymbolTable symbolTable;
+        ast = make_unique<Ast>();
+        Parser parser(stream, symbolTable, *ast);
+        parser.parseProgram();
+        statements = parser.statementCount; });
+
+    lower = bestMilliseconds(runs, [&]
+                             {
+        IntermediateCodeGenerator codeGen;
+        IRLowering(*ast, codeGen).lowerProgram();
+        intermediate = codeGen; });
+
+    // Blocks and edges, dominators and natural loops
+    cfg = bestMilliseconds(runs, [&]
+                           {
+        ControlFlowGraph graph(intermediate.instructions);
+        DominatorTree dominators(graph);
+        LoopInfo loopInfo(graph, dominators);
+        blocks = graph.blockCount();
+        loops = loopInfo.loopCount(); });
+
+    // Each run optimizes a fresh copy; the copy is part of the measurement
+    optimize = bestMilliseconds(runs, [&]
+                                {
+        vector<IrInstr> code = intermediate.instructions;
+        removed = 0;
+        for (const IrPass &pass : irPasses())
+            removed += pass.run(code);
+        optimized = code; });
+
+    regalloc = bestMilliseconds(runs, [&]
+                                { registerAllocation = RegisterAllocator().allocate(optimized); });
+
+    codegen = bestMilliseconds(runs, [&]
+                               {
+        MachineCodeGenerator machineGen;
+        machineGen.generateMachineCode(intermediate.instructions);
+        machineInstructions = machineGen.instructionCount(); });
+    MachineCodeGenerator optimizedGen;
+    optimizedGen.setRegisterAllocation(&registerAllocation);
+    optimizedGen.generateMachineCode(optimized);
+    optimizedMachineInstructions = optimizedGen.instructionCount();
+    PeepholeOptimizer optimizedPeephole;
+    optimizedPeepholeRemoved = optimizedGen.optimizePeephole(optimizedPeephole);
+
+    // Each run rewrites a fresh copy of the unoptimized code, which has the most to remove
+    MachineCodeGenerator unoptimizedGen;
+    unoptimizedGen.generateMachineCode(intermediate.instructions);
+    peepholeMs = bestMilliseconds(runs, [&]
+                                  {
+        MachineCodeGenerator machineGen = unoptimizedGen;
+        peephole = PeepholeOptimizer();
+        peepholeRemoved = machineGen.optimizePeephole(peephole); });
+
+    // Optimized and allocated IR to GNU as source
+    assembly = bestMilliseconds(runs, [&]
+                                { assemblyBytes = x86Assembly(optimized, registerAllocation).size(); });
+
+    // Optimized and allocated IR to machine code mapped executable, without running it
+    jit = bestMilliseconds(runs, [&]
+                           {
+        X86Encoder encoder;
+        encoder.encode(X86CodeGenerator().generate(optimized, registerAllocation));
+        JitCode native(encoder);
+        jitBytes = encoder.bytes.size(); });
+
+    // The old route: format the IR as text and re-parse it
+    codegenText = bestMilliseconds(runs, [&]
+                                   {
+        MachineCodeGenerator machineGen;
+        machineGen.generateMachineCode(intermediate.getInstructionsAsVector()); });
+
+    size_t allocationsBefore = heapAllocations.load();
+    endToEnd = bestMilliseconds(runs, [&]
+                                {
+        Lexer lexer(source);
+        TokenStream<Token> stream(lexer);
+        SymbolTable symbolTable;
+        Ast ast;
+        Parser parser(stream, symbolTable, ast);
+        parser.parseProgram();
+        IntermediateCodeGenerator codeGen;
+        IRLowering(ast, codeGen).lowerProgram();
+        MachineCodeGenerator machineGen;
+        machineGen.generateMachineCode(codeGen.instructions); });
+    allocations = (heapAllocations.load() - allocationsBefore) / runs;
+
+    clog << shapeName(shape) << ": " << program.size() / 1024 << " KB, " << tokens.size() << " tokens, "
+         << statements << " statements, " << intermediate.instructions.size() << " IR in " << blocks << " blocks and " << loops << " loops ("
+         << removed << " optimized away), "
+         << machineInstructions << " machine instructions (" << optimizedMachineInstructions << " optimized), "
+         << memoryOperands(optimized) << " memory operands (" << memoryOperands(optimized, &registerAllocation)
+         << " after register allocation, " << registerAllocation.spilled << " spilled), "
+         << assemblyBytes / 1024 << " KB of x86-64 assembly (" << jitBytes / 1024 << " KB encoded), " << allocations << " allocations end-to-end" << endl;
+    clog << "  peephole removed " << peepholeRemoved << " lines (" << optimizedPeepholeRemoved << " optimized):";
+    for (size_t r = 0; r < peepholeRules().size(); r++)
+        clog << (r ? ", " : " ") << peepholeRules()[r].name << " " << peephole.hits[r];
+    clog << endl;
+    return {{shapeName(shape), "lex", lex},
+            {shapeName(shape), "parse", parse},
+            {shapeName(shape), "lower", lower},
+            {shapeName(shape), "cfg", cfg},
+            {shapeName(shape), "optimize", optimize},
+            {shapeName(shape), "regalloc", regalloc},
+            {shapeName(shape), "codegen", codegen},
+            {shapeName(shape), "peephole", peepholeMs},
+            {shapeName(shape), "asm", assembly},
+            {shapeName(shape), "jit", jit},
+            {shapeName(shape), "codegen-text", codegenText},
+            {shapeName(shape), "end-to-end", endToEnd}};
+}
+
+// Programs the optimizer once got wrong; --check runs each through the JIT with
+// and without the IR passes and register allocation and expects the same result
+struct RegressionProgram
+{
+    const char *name;
+    const char *source;
+};
+
+const vector<RegressionProgram> &regressionPrograms()
+{
+    static const vector<RegressionProgram> programs = {
+        // LICM hoisted the division above the return that guards it
+        {"division after return in loop",
+         "int d = 0; int r = 0; int k = 0; while (k < 10) { k = k + 1; } "
+         "while (1 > 0) { if (k > 5) { return 5; } r = 100 / d; if (r > 3) { break; } } return r;"},
+    };
+    return programs;
+}
+
+// The value main returns, or the error that stopped it
+string runJit(const string &program, bool optimize)
+{
+    try
+    {
+        SourceBuffer source(program);
+        Lexer lexer(source);
+        TokenStream<Token> stream(lexer);
+        SymbolTable symbolTable;
+        Ast ast;
+        Parser parser(stream, symbolTable, ast);
+        parser.parseProgram();
+        IntermediateCodeGenerator codeGen;
+        IRLowering(ast, codeGen).lowerProgram();
+        if (optimize)
+            for (const IrPass &pass : irPasses())
+                pass.run(codeGen.instructions);
+        RegisterAllocation allocation = optimize ? RegisterAllocator().allocate(codeGen.instructions)
+                                                 : RegisterAllocator(RegisterFile("")).allocate(codeGen.instructions);
+        X86Encoder encoder;
+        encoder.encode(X86CodeGenerator().generate(codeGen.instructions, allocation));
+        JitCode native(encoder);
+        return to_string(native.run());
+    }
+    catch (const runtime_error &exception)
+    {
+        return exception.what();
+    }
+}
+
+int checkRegressions()
+{
+    int failures = 0;
+    for (const RegressionProgram &program : regressionPrograms())
+    {
+        string expected = runJit(program.source, false), actual = runJit(program.source, true);
+        bool same = expected == actual;
+        cout << (same ? "ok    " : "FAIL  ") << program.name;
+        if (!same)
+        {
+            cout << ": unoptimized " << expected << ", optimized " << actual;
+            failures++;
+        }
+        cout << endl;
+    }
+    return failures;
+}
+
+map<string, double> loadBaseline(const string &path)
+{
+    map<string, double> baseline;
+    ifstream file(path);
+    string shape, phase;
+    double ms;
+    while (file >> shape >> phase >> ms)
+        baseline[shape + " " + phase] = ms;
+    return baseline;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t units = 5000;
+    int runs = 5;
+    uint32_t seed = 1;
+    double threshold = 20; // percent slower than baseline that counts as a regression
+    string baselinePath, savePath;
+    vector<ProgramShape> shapes;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--emit" && i + 2 < argc)
+        {
+            ProgramShape shape = shapeFromName(argv[i + 1]);
+            if (shape == SHAPE_COUNT)
+            {
+                cerr << "Unknown shape: " << argv[i + 1] << endl;
+                return 1;
+            }
+            uint32_t emitSeed = i + 3 < argc ? (uint32_t)strtoul(argv[i + 3], nullptr, 10) : 1;
+            cout << ProgramGenerator(emitSeed).generate(shape, strtoul(argv[i + 2], nullptr, 10));
+            return 0;
+        }
+        else if (arg == "--check")
+            return checkRegressions() > 0;
+        else if (arg == "--units" && hasValue)
+            units = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--runs" && hasValue)
+            runs = atoi(argv[++i]);
+        else if (arg == "--seed" && hasValue)
+            seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--threshold" && hasValue)
+            threshold = atof(argv[++i]);
+        else if (arg == "--baseline" && hasValue)
+            baselinePath = argv[++i];
+        else if (arg == "--save-baseline" && hasValue)
+            savePath = argv[++i];
+        else if (arg == "--shape" && hasValue && shapeFromName(argv[i + 1]) != SHAPE_COUNT)
+            shapes.push_back(shapeFromName(argv[++i]));
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--units N] [--runs N] [--seed N] [--shape NAME]"
+                 << " [--baseline FILE] [--save-baseline FILE] [--threshold PCT]" << endl
+                 << "       " << argv[0] << " --emit SHAPE UNITS [SEED]" << endl
+                 << "       " << argv[0] << " --check" << endl;
+            return 1;
+        }
+    }
+    if (shapes.empty())
+        for (int shape = 0; shape < SHAPE_COUNT; shape++)
+            shapes.push_back((ProgramShape)shape);
+
+    vector<Measurement> results;
+    for (ProgramShape shape : shapes)
+        for (const Measurement &m : benchmarkShape(shape, units, seed, runs))
+            results.push_back(m);
+
+    map<string, double> baseline;
+    if (!baselinePath.empty())
+    {
+        baseline = loadBaseline(baselinePath);
+        if (baseline.empty())
+        {
+            cerr << "Could not read baseline " << baselinePath << endl;
+            return 1;
+        }
+    }
+
+    cout << "Benchmark suite (" << units << " units per shape, seed " << seed << ", best of " << runs << ")" << endl;
+    cout << left << setw(14) << "shape" << setw(12) << "phase" << right << setw(12) << "ms";
+    if (!baseline.empty())
+        cout << setw(14) << "baseline ms" << setw(10) << "change";
+    cout << endl;
+
+    int regressions = 0;
+    for (const Measurement &m : results)
+    {
+        cout << left << setw(14) << m.shape << setw(12) << m.phase << right << fixed << setprecision(3)
+             << setw(12) << m.ms;
+        auto it = baseline.find(m.shape + " " + m.phase);
+        if (it != baseline.end())
+        {
+            double change = (m.ms / it->second - 1) * 100;
+            cout << setw(14) << it->second << setw(9) << setprecision(1) << showpos << change << "%" << noshowpos;
+            if (change > threshold)
+            {
+                cout << "  REGRESSION";
+                regressions++;
+            }
+        }
+        cout << defaultfloat << setprecision(6) << endl;
+    }
+
+    if (!savePath.empty())
+    {
+        ofstream file(savePath);
+        for (const Measurement &m : results)
+            file << m.shape << " " << m.phase << " " << m.ms << "\n";
+        cout << "Saved baseline to " << savePath << endl;
+    }
+
+    if (regressions > 0)
+    {
+        cout << regressions << " measurement(s) more than " << threshold << "% slower than the baseline" << endl;
+        return 1;
+    }
+    return 0;
+}
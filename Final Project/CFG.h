@@ -0,0 +1,515 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "IR.h"
+using namespace std;
+
+// Control-flow graph over the typed IR.
+//
+// A basic block is a range of instructions that starts at a label, at the start
+// of the program, after a jump, branch or return or after FUNC or END FUNC, and
+// runs up to the next such point. Blocks are numbered in program order and stored
+// contiguously; successor and predecessor lists are flat arrays indexed by
+// per-block offsets. Building the graph is a constant number of linear passes
+// over the instructions.
+//
+// A function definition does not run its body, so the block ending at FUNC leads
+// both into the body and past the matching END FUNC; analyses then hold whether
+// or not the body runs where it is defined.
+
+typedef uint32_t BlockId;
+const BlockId NoBlock = 0xFFFFFFFFu;
+
+struct BasicBlock
+{
+    uint32_t begin, end; // instruction range [begin, end)
+};
+
+// Pointer range over one block's successors, predecessors or children
+struct BlockList
+{
+    const BlockId *first, *last;
+
+    const BlockId *begin() const
+    {
+        return first;
+    }
+    const BlockId *end() const
+    {
+        return last;
+    }
+    size_t size() const
+    {
+        return last - first;
+    }
+};
+
+// Jumps and branches, the instructions with a label to go to
+inline bool isJump(IrOpcode opcode)
+{
+    return opcode == IR_JUMP || opcode == IR_BRANCH || isCompareBranch(opcode);
+}
+
+inline bool isBlockEnd(IrOpcode opcode)
+{
+    return isJump(opcode) || opcode == IR_RETURN;
+}
+
+// True if control can go on to the next instruction
+inline bool fallsThrough(IrOpcode opcode)
+{
+    return opcode != IR_JUMP && opcode != IR_RETURN;
+}
+
+// Label a jump or branch goes to
+inline uint32_t jumpTarget(const IrInstr &instr)
+{
+    return instr.opcode == IR_JUMP ? instr.a : instr.dst;
+}
+
+class ControlFlowGraph
+{
+public:
+    explicit ControlFlowGraph(const vector<IrInstr> &code)
+    {
+        findBlocks(code);
+        connect(code);
+        order();
+    }
+
+    size_t blockCount() const
+    {
+        return blocks.size();
+    }
+
+    const BasicBlock &block(BlockId b) const
+    {
+        return blocks[b];
+    }
+
+    BlockList successors(BlockId b) const
+    {
+        return {succs.data() + succOffset[b], succs.data() + succOffset[b + 1]};
+    }
+
+    BlockList predecessors(BlockId b) const
+    {
+        return {preds.data() + predOffset[b], preds.data() + predOffset[b + 1]};
+    }
+
+    // True if control can leave the program from the end of b: it returns, falls
+    // off the end of the code or jumps to a label that is never defined
+    bool exits(BlockId b) const
+    {
+        return exitFlags[b];
+    }
+
+    // Block a label starts, or NoBlock
+    BlockId blockOfLabel(uint32_t label) const
+    {
+        return label < labelBlock.size() ? labelBlock[label] : NoBlock;
+    }
+
+    // Blocks reachable from the entry (block 0), in reverse postorder and postorder
+    const vector<BlockId> &reversePostorder() const
+    {
+        return rpo;
+    }
+    const vector<BlockId> &postorder() const
+    {
+        return post;
+    }
+
+    bool reachable(BlockId b) const
+    {
+        return rpoIndex[b] != NoBlock;
+    }
+
+    // Position of a reachable block in reverse postorder
+    uint32_t rpoNumber(BlockId b) const
+    {
+        return rpoIndex[b];
+    }
+
+private:
+    vector<BasicBlock> blocks;
+    vector<uint32_t> succOffset, predOffset; // blockCount() + 1 entries each
+    vector<BlockId> succs, preds;
+    vector<bool> exitFlags;
+    vector<BlockId> labelBlock;
+    vector<BlockId> skipTo; // per block ending at FUNC: the block after END FUNC
+    vector<BlockId> rpo, post;
+    vector<uint32_t> rpoIndex;
+
+    void findBlocks(const vector<IrInstr> &code)
+    {
+        uint32_t labels = 0;
+        for (const IrInstr &instr : code)
+        {
+            if (instr.opcode == IR_LABEL && instr.a >= labels)
+                labels = instr.a + 1;
+            else if (isJump(instr.opcode) && jumpTarget(instr) >= labels)
+                labels = jumpTarget(instr) + 1;
+        }
+        labelBlock.assign(labels, NoBlock);
+
+        vector<pair<BlockId, BlockId>> skips; // block ending at FUNC, block after END FUNC
+        vector<BlockId> open;                 // definitions entered, innermost last
+        for (uint32_t i = 0; i < code.size(); i++)
+        {
+            if (i == 0 || code[i].opcode == IR_LABEL || isBlockEnd(code[i - 1].opcode) ||
+                code[i - 1].opcode == IR_FUNC || code[i - 1].opcode == IR_END_FUNC)
+            {
+                if (!blocks.empty())
+                    blocks.back().end = i;
+                blocks.push_back({i, i});
+            }
+            if (code[i].opcode == IR_LABEL && labelBlock[code[i].a] == NoBlock)
+                labelBlock[code[i].a] = (BlockId)blocks.size() - 1;
+            else if (code[i].opcode == IR_FUNC)
+                open.push_back((BlockId)blocks.size() - 1);
+            else if (code[i].opcode == IR_END_FUNC && !open.empty())
+            {
+                skips.push_back({open.back(), (BlockId)blocks.size()}); // the next block to start
+                open.pop_back();
+            }
+        }
+        if (!blocks.empty())
+            blocks.back().end = (uint32_t)code.size();
+        skipTo.assign(blocks.size(), NoBlock);
+        for (auto [from, to] : skips)
+            skipTo[from] = to;
+    }
+
+    void connect(const vector<IrInstr> &code)
+    {
+        BlockId count = (BlockId)blocks.size();
+        succOffset.assign(count + 1, 0);
+        exitFlags.assign(count, false);
+        succs.reserve(count * 2);
+        for (BlockId b = 0; b < count; b++)
+        {
+            succOffset[b] = (uint32_t)succs.size();
+            const IrInstr &last = code[blocks[b].end - 1];
+            BlockId target = isJump(last.opcode) ? blockOfLabel(jumpTarget(last)) : NoBlock;
+            bool next = fallsThrough(last.opcode);
+            if (next)
+            {
+                if (b + 1 < count)
+                    succs.push_back(b + 1);
+                else
+                    exitFlags[b] = true;
+            }
+            if (last.opcode == IR_RETURN)
+                exitFlags[b] = true; // leaves the program or the function it is in
+            else if (isJump(last.opcode))
+            {
+                if (target == NoBlock)
+                    exitFlags[b] = true;
+                else if (!next || target != b + 1)
+                    succs.push_back(target);
+            }
+            if (skipTo[b] != NoBlock)
+            {
+                if (skipTo[b] < count)
+                    succs.push_back(skipTo[b]);
+                else
+                    exitFlags[b] = true; // nothing follows the definition
+            }
+        }
+        succOffset[count] = (uint32_t)succs.size();
+
+        // Predecessors by counting sort over the successor lists
+        predOffset.assign(count + 1, 0);
+        for (BlockId s : succs)
+            predOffset[s + 1]++;
+        for (BlockId b = 0; b < count; b++)
+            predOffset[b + 1] += predOffset[b];
+        preds.resize(succs.size());
+        vector<uint32_t> fill(predOffset.begin(), predOffset.end() - 1);
+        for (BlockId b = 0; b < count; b++)
+            for (BlockId s : successors(b))
+                preds[fill[s]++] = b;
+    }
+
+    // Iterative depth-first search from the entry
+    void order()
+    {
+        BlockId count = (BlockId)blocks.size();
+        rpoIndex.assign(count, NoBlock);
+        if (count == 0)
+            return;
+        post.reserve(count);
+        vector<bool> visited(count, false);
+        vector<pair<BlockId, uint32_t>> stack; // block, next successor to visit
+        stack.push_back({0, 0});
+        visited[0] = true;
+        while (!stack.empty())
+        {
+            auto &top = stack.back();
+            BlockList next = successors(top.first);
+            if (top.second < next.size())
+            {
+                BlockId s = next.first[top.second++];
+                if (!visited[s])
+                {
+                    visited[s] = true;
+                    stack.push_back({s, 0});
+                }
+                continue;
+            }
+            post.push_back(top.first);
+            stack.pop_back();
+        }
+        rpo.assign(post.rbegin(), post.rend());
+        for (uint32_t i = 0; i < rpo.size(); i++)
+            rpoIndex[rpo[i]] = i;
+    }
+};
+
+// Immediate dominators of the reachable blocks, computed with the iterative
+// algorithm of Cooper, Harvey and Kennedy over reverse postorder. Dominance
+// queries are constant time through pre/post numbers of the dominator tree.
+class DominatorTree
+{
+public:
+    explicit DominatorTree(const ControlFlowGraph &cfg) : cfg(cfg)
+    {
+        computeIdoms();
+        buildTree();
+    }
+
+    // Immediate dominator; the entry is its own, unreachable blocks have NoBlock
+    BlockId idom(BlockId b) const
+    {
+        return idoms[b];
+    }
+
+    bool dominates(BlockId a, BlockId b) const
+    {
+        return idoms[a] != NoBlock && idoms[b] != NoBlock && pre[a] <= pre[b] && postNumber[b] <= postNumber[a];
+    }
+
+    BlockList children(BlockId b) const
+    {
+        return {kids.data() + kidOffset[b], kids.data() + kidOffset[b + 1]};
+    }
+
+private:
+    const ControlFlowGraph &cfg;
+    vector<BlockId> idoms;
+    vector<uint32_t> kidOffset;
+    vector<BlockId> kids;
+    vector<uint32_t> pre, postNumber;
+
+    void computeIdoms()
+    {
+        const vector<BlockId> &rpo = cfg.reversePostorder();
+        idoms.assign(cfg.blockCount(), NoBlock);
+        if (rpo.empty())
+            return;
+        idoms[rpo[0]] = rpo[0];
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (size_t i = 1; i < rpo.size(); i++)
+            {
+                BlockId b = rpo[i];
+                BlockId newIdom = NoBlock;
+                for (BlockId p : cfg.predecessors(b))
+                {
+                    if (idoms[p] == NoBlock)
+                        continue;
+                    newIdom = newIdom == NoBlock ? p : intersect(p, newIdom);
+                }
+                if (idoms[b] != newIdom)
+                {
+                    idoms[b] = newIdom;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    BlockId intersect(BlockId a, BlockId b) const
+    {
+        while (a != b)
+        {
+            while (cfg.rpoNumber(a) > cfg.rpoNumber(b))
+                a = idoms[a];
+            while (cfg.rpoNumber(b) > cfg.rpoNumber(a))
+                b = idoms[b];
+        }
+        return a;
+    }
+
+    void buildTree()
+    {
+        BlockId count = (BlockId)cfg.blockCount();
+        kidOffset.assign(count + 1, 0);
+        for (BlockId b = 0; b < count; b++)
+            if (idoms[b] != NoBlock && idoms[b] != b)
+                kidOffset[idoms[b] + 1]++;
+        for (BlockId b = 0; b < count; b++)
+            kidOffset[b + 1] += kidOffset[b];
+        kids.resize(kidOffset[count]);
+        vector<uint32_t> fill(kidOffset.begin(), kidOffset.end() - 1);
+        for (BlockId b = 0; b < count; b++)
+            if (idoms[b] != NoBlock && idoms[b] != b)
+                kids[fill[idoms[b]]++] = b;
+
+        pre.assign(count, 0);
+        postNumber.assign(count, 0);
+        if (cfg.reversePostorder().empty())
+            return;
+        uint32_t preCounter = 0, postCounter = 0;
+        vector<pair<BlockId, uint32_t>> stack = {{cfg.reversePostorder()[0], 0}};
+        pre[stack[0].first] = preCounter++;
+        while (!stack.empty())
+        {
+            auto &top = stack.back();
+            BlockList next = children(top.first);
+            if (top.second < next.size())
+            {
+                BlockId child = next.first[top.second++];
+                pre[child] = preCounter++;
+                stack.push_back({child, 0});
+                continue;
+            }
+            postNumber[top.first] = postCounter++;
+            stack.pop_back();
+        }
+    }
+};
+
+// Natural loops: a back edge goes from a block to a block that dominates it (the
+// header), and the loop is every block that reaches the back edge without passing
+// through the header. Loops sharing a header are merged. Inner loops are found
+// before the loops that contain them. Irreducible cycles are not loops.
+class LoopInfo
+{
+public:
+    static constexpr uint32_t NoLoop = 0xFFFFFFFFu;
+
+    struct Loop
+    {
+        BlockId header;
+        uint32_t parent; // enclosing loop or NoLoop
+        uint32_t depth;  // 1 for outermost loops
+    };
+
+    LoopInfo(const ControlFlowGraph &cfg, const DominatorTree &dominators)
+    {
+        findLoops(cfg, dominators);
+        collectBlocks(cfg);
+    }
+
+    size_t loopCount() const
+    {
+        return loops.size();
+    }
+
+    const Loop &loop(uint32_t l) const
+    {
+        return loops[l];
+    }
+
+    // Innermost loop containing b, or NoLoop
+    uint32_t loopOf(BlockId b) const
+    {
+        return innermost[b];
+    }
+
+    uint32_t depth(BlockId b) const
+    {
+        return innermost[b] == NoLoop ? 0 : loops[innermost[b]].depth;
+    }
+
+    bool contains(uint32_t l, BlockId b) const
+    {
+        for (uint32_t inner = innermost[b]; inner != NoLoop; inner = loops[inner].parent)
+            if (inner == l)
+                return true;
+        return false;
+    }
+
+    // Every block of the loop, including those of nested loops, in program order
+    BlockList blocks(uint32_t l) const
+    {
+        return {members.data() + memberOffset[l], members.data() + memberOffset[l + 1]};
+    }
+
+private:
+    vector<Loop> loops;
+    vector<uint32_t> innermost;
+    vector<uint32_t> memberOffset;
+    vector<BlockId> members;
+
+    uint32_t outermost(uint32_t l) const
+    {
+        while (loops[l].parent != NoLoop)
+            l = loops[l].parent;
+        return l;
+    }
+
+    void findLoops(const ControlFlowGraph &cfg, const DominatorTree &dominators)
+    {
+        innermost.assign(cfg.blockCount(), NoLoop);
+        vector<BlockId> work;
+        // Postorder visits a header after every header nested inside its loop
+        for (BlockId header : cfg.postorder())
+        {
+            for (BlockId p : cfg.predecessors(header))
+                if (dominators.dominates(header, p))
+                    work.push_back(p);
+            if (work.empty())
+                continue;
+
+            uint32_t l = (uint32_t)loops.size();
+            loops.push_back({header, NoLoop, 0});
+            innermost[header] = l;
+            while (!work.empty())
+            {
+                BlockId b = work.back();
+                work.pop_back();
+                if (!cfg.reachable(b))
+                    continue;
+                if (innermost[b] == NoLoop)
+                {
+                    innermost[b] = l;
+                    for (BlockId p : cfg.predecessors(b))
+                        work.push_back(p);
+                    continue;
+                }
+                // Already in a loop: if it is a nested one, adopt it and continue
+                // from its header
+                uint32_t inner = outermost(innermost[b]);
+                if (inner == l)
+                    continue;
+                loops[inner].parent = l;
+                for (BlockId p : cfg.predecessors(loops[inner].header))
+                    work.push_back(p);
+            }
+        }
+        // Parents are found after their children
+        for (size_t i = loops.size(); i-- > 0;)
+            loops[i].depth = loops[i].parent == NoLoop ? 1 : loops[loops[i].parent].depth + 1;
+    }
+
+    void collectBlocks(const ControlFlowGraph &cfg)
+    {
+        memberOffset.assign(loops.size() + 1, 0);
+        for (BlockId b = 0; b < cfg.blockCount(); b++)
+            for (uint32_t l = innermost[b]; l != NoLoop; l = loops[l].parent)
+                memberOffset[l + 1]++;
+        for (size_t l = 0; l < loops.size(); l++)
+            memberOffset[l + 1] += memberOffset[l];
+        members.resize(memberOffset[loops.size()]);
+        vector<uint32_t> fill(memberOffset.begin(), memberOffset.end() - 1);
+        for (BlockId b = 0; b < cfg.blockCount(); b++)
+            for (uint32_t l = innermost[b]; l != NoLoop; l = loops[l].parent)
+                members[fill[l]++] = b;
+    }
+};
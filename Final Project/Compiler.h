@@ -0,0 +1,1470 @@
+#pragma once
+
+// Front end and code generators of the final project compiler, shared by the
+// CustomCompiler driver and the benchmark suite.
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <map>
+#include <stack>
+#include <vector>
+#include <sstream>
+#include <stdexcept>
+#include <charconv>
+#include "Lexer.h"
+#include "Ast.h"
+#include "IR.h"
+#include "Peephole.h"
+#include "RegisterAllocator.h"
+using namespace std;
+
+// Symbol Table Class. Names, types and categories are interned symbol ids, so
+// declarations and lookups are plain array indexing.
+class SymbolTable
+{
+public:
+    void declareVariable(SymbolId name, SymbolId type)
+    {
+        if (isDeclared(name))
+        {
+            throw runtime_error("Semantic error: Variable '" + string(symbols.name(name)) + "' is already declared.");
+        }
+        slot(variableTypes, name) = type;
+    }
+
+    void declareType(SymbolId name, SymbolId category)
+    {
+        if (name < typeCategories.size() && typeCategories[name] != NoSymbol)
+        {
+            throw runtime_error("Semantic error: Type '" + string(symbols.name(name)) + "' is already declared.");
+        }
+        slot(typeCategories, name) = category;
+    }
+
+    SymbolId getVariableType(SymbolId name) const
+    {
+        if (!isDeclared(name))
+        {
+            throw runtime_error("Semantic error: Variable '" + string(symbols.name(name)) + "' is not declared.");
+        }
+        return variableTypes[name];
+    }
+
+    bool isDeclared(SymbolId name) const
+    {
+        return name < variableTypes.size() && variableTypes[name] != NoSymbol;
+    }
+
+    bool isType(SymbolId name) const
+    {
+        static const SymbolId structCategory = symbols.intern("struct");
+        static const SymbolId classCategory = symbols.intern("class");
+        if (name >= typeCategories.size())
+            return false;
+        return typeCategories[name] == structCategory || typeCategories[name] == classCategory;
+    }
+
+private:
+    vector<SymbolId> variableTypes;  // name -> type
+    vector<SymbolId> typeCategories; // typeName -> category
+
+    static SymbolId &slot(vector<SymbolId> &table, SymbolId name)
+    {
+        if (name >= table.size())
+            table.resize(max<size_t>(name + 1, symbols.size()), NoSymbol);
+        return table[name];
+    }
+};
+
+// Intermediate Code Generator Class. Holds the typed IR (see IR.h); the text form
+// is only built when printing or for consumers that still want strings.
+class IntermediateCodeGenerator
+{
+public:
+    vector<IrInstr> instructions;
+    int tempCount = 0; // numbers both temporaries and labels
+
+    Operand newTemp()
+    {
+        return Operand(OP_TEMP, tempCount++);
+    }
+
+    Operand newLabel()
+    {
+        return Operand(OP_LABEL, tempCount++);
+    }
+
+    void addInstruction(const IrInstr &instr)
+    {
+        instructions.push_back(instr);
+    }
+
+    void printInstructions() const
+    {
+        for (const auto &instr : instructions)
+        {
+            cout << irText(instr) << endl;
+        }
+    }
+
+    vector<string> getInstructionsAsVector() const
+    {
+        vector<string> text;
+        text.reserve(instructions.size());
+        for (const auto &instr : instructions)
+            text.push_back(irText(instr));
+        return text;
+    }
+};
+// Parser Class. Builds the AST; IR is produced afterwards by IRLowering.
+class Parser
+{
+public:
+    Parser(TokenStream<Token> &tokens, SymbolTable &symTable, Ast &ast)
+        : tokens(tokens), symTable(symTable), ast(ast) {}
+
+    size_t statementCount = 0; // statements parsed so far, for --time-report
+
+    void parseProgram()
+    {
+        NodeListBuilder program(ast);
+        while (tokens.peek().type != T_EOF)
+        {
+            program.append(parseStatement());
+        }
+        ast.root = program.head();
+    }
+
+private:
+    TokenStream<Token> &tokens; // pulled from the lexer as parsing proceeds
+    SymbolTable &symTable;
+    Ast &ast;
+    int breakableDepth = 0; // enclosing switch and loop statements
+
+    NodeId parseStatement()
+    {
+        statementCount++;
+        if (isDeclarationStart())
+        {
+            return parseDeclaration();
+        }
+        else if (tokens.peek().type == T_STRUCT || tokens.peek().type == T_CLASS)
+        {
+            return parseTypeDeclaration();
+        }
+        else if (tokens.peek().type == T_IF)
+        {
+            return parseIfStatement();
+        }
+        else if (tokens.peek().type == T_WHILE)
+        {
+            return parseWhileStatement();
+        }
+        else if (tokens.peek().type == T_FOR)
+        {
+            return parseForStatement();
+        }
+        else if (tokens.peek().type == T_SWITCH)
+        {
+            return parseSwitchStatement();
+        }
+        else if (tokens.peek().type == T_FUNC)
+        {
+            return parseFunction();
+        }
+        else if (tokens.peek().type == T_RETURN)
+        {
+            return parseReturnStatement();
+        }
+        else if (tokens.peek().type == T_BREAK)
+        {
+            return parseBreakStatement();
+        }
+        else if (tokens.peek().type == T_LBRACE)
+        {
+            return parseBlock();
+        }
+        else if (tokens.peek().type == T_ID)
+        {
+            return parseAssignmentOrStructAccess();
+        }
+        else if (tokens.peek().type == T_SEMICOLON)
+        {
+            tokens.advance(); // Empty statement
+            return ast.add(N_EMPTY);
+        }
+        else
+        {
+            error("Unexpected token in parseStatement");
+            return NoNode;
+        }
+    }
+
+    bool isDeclarationStart()
+    {
+        return (tokens.peek().type == T_INT ||
+                tokens.peek().type == T_BOOL ||
+                tokens.peek().type == T_STRING_TYPE);
+    }
+
+    NodeId parseTypeDeclaration()
+    {
+        if (tokens.peek().type == T_STRUCT)
+        {
+            return parseStructDeclaration();
+        }
+        else if (tokens.peek().type == T_CLASS)
+        {
+            return parseClassDeclaration();
+        }
+        else
+        {
+            error("Unknown type declaration");
+            return NoNode;
+        }
+    }
+
+    NodeId parseFunction()
+    {
+        expect(T_FUNC);
+        SymbolId funcName = expectIdentifier();
+        expect(T_LPAREN);
+        expect(T_RPAREN);
+        expect(T_LBRACE);
+        NodeListBuilder body(ast);
+        while (tokens.peek().type != T_RBRACE && tokens.peek().type != T_EOF)
+        {
+            body.append(parseStatement());
+        }
+        expect(T_RBRACE);
+        return ast.add(N_FUNC, funcName, body.head());
+    }
+
+    NodeId parseDeclaration()
+    {
+        static const SymbolId intType = symbols.intern("int");
+        static const SymbolId boolType = symbols.intern("bool");
+        static const SymbolId stringType = symbols.intern("string");
+        TokenType type = tokens.peek().type;
+        SymbolId typeName = NoSymbol;
+        if (type == T_INT)
+            typeName = intType;
+        else if (type == T_BOOL)
+            typeName = boolType;
+        else if (type == T_STRING_TYPE)
+            typeName = stringType;
+        else
+            error("Unknown type in declaration");
+
+        tokens.advance();
+        SymbolId varName = expectIdentifier();
+        symTable.declareVariable(varName, typeName);
+        // Handle optional initialization
+        NodeId init = NoNode;
+        if (tokens.peek().type == T_ASSIGN)
+        {
+            tokens.advance(); // Consume '='
+            init = parseExpression();
+        }
+        expect(T_SEMICOLON);
+        NodeId node = ast.add(N_DECLARATION, varName, init);
+        ast[node].op = (uint8_t)type;
+        return node;
+    }
+
+    NodeId parseAssignmentOrStructAccess()
+    {
+        SymbolId lhs = parseLValue();
+        if (tokens.peek().type == T_ASSIGN)
+        {
+            tokens.advance();
+            NodeId rhs = parseExpression();
+            expect(T_SEMICOLON);
+            return ast.add(N_ASSIGN, lhs, rhs);
+        }
+        else
+        {
+            error("Expected assignment after lvalue");
+            return NoNode;
+        }
+    }
+
+    // An identifier or member path (a.b.c); the whole path is one symbol
+    SymbolId parseLValue()
+    {
+        SymbolId id = expectIdentifier();
+        while (tokens.peek().type == T_DOT)
+        {
+            tokens.advance(); // Skip '.'
+            SymbolId member = expectIdentifier();
+            id = symbols.intern(string(symbols.name(id)) + "." + string(symbols.name(member)));
+        }
+        return id;
+    }
+
+    NodeId parseIfStatement()
+    {
+        expect(T_IF);
+        expect(T_LPAREN);
+        NodeId cond = parseExpression();
+        expect(T_RPAREN);
+        NodeId thenBranch = parseStatement();
+        NodeId elseBranch = NoNode;
+        if (tokens.peek().type == T_ELSE)
+        {
+            expect(T_ELSE);
+            elseBranch = parseStatement();
+        }
+        return ast.add(N_IF, cond, thenBranch, elseBranch);
+    }
+
+    NodeId parseReturnStatement()
+    {
+        expect(T_RETURN);
+        NodeId expr = parseExpression();
+        expect(T_SEMICOLON);
+        return ast.add(N_RETURN, expr);
+    }
+
+    NodeId parseBreakStatement()
+    {
+        expect(T_BREAK);
+        expect(T_SEMICOLON);
+        if (breakableDepth == 0)
+        {
+            cout << "Error: 'break;' found outside of switch or loop at line "
+                 << tokens.peek().lineNumber << endl;
+            exit(1);
+        }
+        return ast.add(N_BREAK);
+    }
+
+    NodeId parseBlock()
+    {
+        expect(T_LBRACE);
+        NodeListBuilder body(ast);
+        while (tokens.peek().type != T_RBRACE && tokens.peek().type != T_EOF)
+        {
+            body.append(parseStatement());
+        }
+        expect(T_RBRACE);
+        return ast.add(N_BLOCK, body.head());
+    }
+
+    NodeId parseExpression()
+    {
+        NodeId left = parseTerm();
+
+        while (tokens.peek().type == T_PLUS || tokens.peek().type == T_MINUS ||
+               tokens.peek().type == T_GT || tokens.peek().type == T_LT ||
+               tokens.peek().type == T_EQ || tokens.peek().type == T_NEQ ||
+               tokens.peek().type == T_GTE || tokens.peek().type == T_LTE)
+        {
+            TokenType op = tokens.peek().type;
+            tokens.advance();
+            NodeId right = parseTerm();
+            left = binary(op, left, right);
+        }
+        return left;
+    }
+
+    NodeId parseTerm()
+    {
+        NodeId left = parseFactor();
+        while (tokens.peek().type == T_MUL || tokens.peek().type == T_DIV)
+        {
+            TokenType op = tokens.peek().type;
+            tokens.advance();
+            NodeId right = parseFactor();
+            left = binary(op, left, right);
+        }
+        return left;
+    }
+
+    NodeId binary(TokenType op, NodeId left, NodeId right)
+    {
+        NodeId node = ast.add(N_BINARY, left, right);
+        ast[node].op = (uint8_t)op;
+        return node;
+    }
+
+    NodeId parseFactor()
+    {
+        if (tokens.peek().type == T_NUM)
+        {
+            NodeId node = ast.add(N_NUMBER, symbols.intern(tokens.peek().value));
+            tokens.advance();
+            return node;
+        }
+        else if (tokens.peek().type == T_ID)
+        {
+            return ast.add(N_NAME, parseLValue());
+        }
+        else if (tokens.peek().type == T_LPAREN)
+        {
+            tokens.advance();
+            NodeId expr = parseExpression();
+            expect(T_RPAREN);
+            return expr;
+        }
+        else if (tokens.peek().type == T_STRING)
+        {
+            NodeId node = ast.add(N_STRING, symbols.intern(tokens.peek().value));
+            tokens.advance();
+            return node;
+        }
+        else if (tokens.peek().type == T_TRUE || tokens.peek().type == T_FALSE)
+        {
+            NodeId node = ast.add(N_BOOL, symbols.intern(tokens.peek().value));
+            tokens.advance();
+            return node;
+        }
+        else
+        {
+            error("Unexpected token in parseFactor");
+            return NoNode;
+        }
+    }
+
+    void expect(TokenType type)
+    {
+        if (tokens.peek().type != type)
+        {
+            error("Unexpected token");
+        }
+        tokens.advance();
+    }
+
+    SymbolId expectIdentifier()
+    {
+        if (tokens.peek().type != T_ID)
+        {
+            error("Unexpected token");
+        }
+        SymbolId symbol = tokens.peek().symbol;
+        tokens.advance();
+        return symbol;
+    }
+
+    NodeId parseWhileStatement()
+    {
+        expect(T_WHILE);
+        expect(T_LPAREN);
+        NodeId cond = parseExpression();
+        expect(T_RPAREN);
+        breakableDepth++;
+        NodeId body = parseStatement();
+        breakableDepth--;
+        return ast.add(N_WHILE, cond, body);
+    }
+
+    NodeId parseForStatement()
+    {
+        expect(T_FOR);
+        expect(T_LPAREN);
+        // Handle initialization
+        NodeId init;
+        if (isDeclarationStart())
+        {
+            init = parseDeclaration();
+        }
+        else
+        {
+            init = parseAssignmentOrStructAccess();
+        }
+        // Handle condition
+        NodeId cond = parseExpression();
+        expect(T_SEMICOLON);
+        // Parse increment as an assignment
+        SymbolId incrementLHS = parseLValue(); // may be a struct member
+        expect(T_ASSIGN);
+        NodeId increment = ast.add(N_ASSIGN, incrementLHS, parseExpression());
+        expect(T_RPAREN);
+
+        breakableDepth++;
+        NodeId body = parseStatement();
+        breakableDepth--;
+        return ast.add(N_FOR, init, cond, increment, body);
+    }
+
+    NodeId parseSwitchStatement()
+    {
+        expect(T_SWITCH);
+        expect(T_LPAREN);
+        NodeId expr = parseExpression();
+        expect(T_RPAREN);
+        expect(T_LBRACE);
+
+        breakableDepth++;
+        NodeListBuilder cases(ast);
+        while (tokens.peek().type == T_CASE || tokens.peek().type == T_DEFAULT)
+        {
+            if (tokens.peek().type == T_CASE)
+            {
+                expect(T_CASE);
+                if (tokens.peek().type != T_NUM)
+                {
+                    error("Unexpected token");
+                }
+                SymbolId caseValue = symbols.intern(tokens.peek().value);
+                tokens.advance();
+                expect(T_COLON);
+                cases.append(ast.add(N_CASE, caseValue, parseStatement()));
+            }
+            else if (tokens.peek().type == T_DEFAULT)
+            {
+                expect(T_DEFAULT);
+                expect(T_COLON);
+                cases.append(ast.add(N_DEFAULT, NoNode, parseStatement()));
+            }
+        }
+        breakableDepth--;
+
+        expect(T_RBRACE);
+        return ast.add(N_SWITCH, expr, cases.head());
+    }
+
+    NodeId parseStructDeclaration()
+    {
+        expect(T_STRUCT);
+        SymbolId structName = expectIdentifier();
+        NodeId members = parseMembers();
+        symTable.declareType(structName, symbols.intern("struct"));
+        return ast.add(N_STRUCT, structName, members);
+    }
+
+    NodeId parseClassDeclaration()
+    {
+        expect(T_CLASS);
+        SymbolId className = expectIdentifier();
+        NodeId members = parseMembers();
+        symTable.declareType(className, symbols.intern("class"));
+        return ast.add(N_CLASS, className, members);
+    }
+
+    // { declarations } ;
+    NodeId parseMembers()
+    {
+        expect(T_LBRACE);
+        NodeListBuilder members(ast);
+        while (tokens.peek().type != T_RBRACE && tokens.peek().type != T_EOF)
+        {
+            members.append(parseDeclaration());
+        }
+        expect(T_RBRACE);
+        expect(T_SEMICOLON);
+        return members.head();
+    }
+
+    void error(const string &message)
+    {
+        cout << "Syntax error at line " << tokens.peek().lineNumber << ": " << message
+             << " Unexpected token: '" << tokens.peek().value << "' (type: " << tokens.peek().type << ")" << endl;
+        exit(1);
+    }
+};
+
+// Dispatch strategies for switch statements, picked from the number of cases and
+// how densely they fill the range between the smallest and largest value
+enum SwitchStrategy
+{
+    SWITCH_LINEAR,        // one equality test per case
+    SWITCH_BINARY_SEARCH, // balanced tree of ordered compares, linear at the leaves
+    SWITCH_JUMP_TABLE     // bounds check and an indexed jump
+};
+
+const size_t SwitchLinearMax = 4; // cases tested one by one before another strategy pays off
+
+inline SwitchStrategy chooseSwitchStrategy(size_t cases, int64_t low, int64_t high)
+{
+    if (cases <= SwitchLinearMax)
+        return SWITCH_LINEAR;
+    // One table entry per value in the range; at least half of them must be cases
+    uint64_t range = uint64_t(high) - uint64_t(low);
+    if (range < 2 * cases)
+        return SWITCH_JUMP_TABLE;
+    return SWITCH_BINARY_SEARCH;
+}
+
+// Value of an integer case label
+inline bool caseValue(SymbolId symbol, int64_t &value)
+{
+    string_view text = symbols.name(symbol);
+    auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    return error == errc() && end == text.data() + text.size();
+}
+
+// Lowers the AST to three-address intermediate code, one statement at a time in
+// source order, so temporaries and labels are numbered as they always were.
+class IRLowering
+{
+public:
+    IRLowering(const Ast &ast, IntermediateCodeGenerator &icg) : ast(ast), icg(icg) {}
+
+    void lowerProgram()
+    {
+        icg.instructions.reserve(icg.instructions.size() + ast.size());
+        lowerList(ast.root);
+    }
+
+private:
+    const Ast &ast;
+    IntermediateCodeGenerator &icg;
+    stack<Operand> breakTargets; // end labels of the enclosing switch and loop statements
+
+    struct SwitchCase
+    {
+        int64_t value;
+        Operand constant;
+        Operand label;
+    };
+    vector<SwitchCase> cases; // of the switch being dispatched, reused across switches
+
+    void lowerList(NodeId first)
+    {
+        for (NodeId id = first; id != NoNode; id = ast[id].next)
+            lowerStatement(id);
+    }
+
+    void emit(IrOpcode opcode, Operand dst = Operand(), Operand a = Operand(), Operand b = Operand())
+    {
+        icg.addInstruction(IrInstr(opcode, dst, a, b));
+    }
+
+    void lowerStatement(NodeId id)
+    {
+        const Node &node = ast[id];
+        switch (node.kind)
+        {
+        case N_DECLARATION:
+            if (node.b != NoNode)
+            {
+                Operand expr = lowerExpression(node.b);
+                emit(IR_COPY, Operand(OP_VAR, node.a), expr);
+            }
+            break;
+        case N_ASSIGN:
+        {
+            Operand rhs = lowerExpression(node.b);
+            emit(IR_COPY, Operand(OP_VAR, node.a), rhs);
+            break;
+        }
+        case N_IF:
+            lowerIf(node);
+            break;
+        case N_WHILE:
+            lowerWhile(node);
+            break;
+        case N_FOR:
+            lowerFor(node);
+            break;
+        case N_SWITCH:
+            lowerSwitch(node);
+            break;
+        case N_FUNC:
+            emit(IR_FUNC, Operand(), Operand(OP_FUNC, node.a));
+            lowerList(node.b);
+            emit(IR_END_FUNC, Operand(), Operand(OP_FUNC, node.a));
+            break;
+        case N_RETURN:
+        {
+            Operand expr = lowerExpression(node.a);
+            emit(IR_RETURN, Operand(), expr);
+            break;
+        }
+        case N_BREAK:
+            lowerBreak();
+            break;
+        case N_BLOCK:
+            lowerList(node.a);
+            break;
+        case N_STRUCT:
+        case N_CLASS:
+            lowerList(node.b); // member initializers
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Returns the operand holding the value: a variable, a constant or a temporary
+    Operand lowerExpression(NodeId id)
+    {
+        const Node &node = ast[id];
+        switch (node.kind)
+        {
+        case N_NUMBER:
+        case N_BOOL:
+            return Operand(OP_CONST, node.a);
+        case N_NAME:
+            return Operand(OP_VAR, node.a);
+        case N_STRING:
+            return Operand(OP_STRING, node.a);
+        case N_BINARY:
+        {
+            Operand left = lowerExpression(node.a);
+            Operand right = lowerExpression(node.b);
+            Operand temp = icg.newTemp();
+            emit(binaryOpcode((TokenType)node.op), temp, left, right);
+            return temp;
+        }
+        default:
+            return Operand();
+        }
+    }
+
+    static IrOpcode binaryOpcode(TokenType op)
+    {
+        switch (op)
+        {
+        case T_PLUS:
+            return IR_ADD;
+        case T_MINUS:
+            return IR_SUB;
+        case T_MUL:
+            return IR_MUL;
+        case T_DIV:
+            return IR_DIV;
+        case T_GT:
+            return IR_GT;
+        case T_LT:
+            return IR_LT;
+        case T_EQ:
+            return IR_EQ;
+        case T_NEQ:
+            return IR_NE;
+        case T_GTE:
+            return IR_GE;
+        default:
+            return IR_LE;
+        }
+    }
+
+    void lowerIf(const Node &node)
+    {
+        Operand cond = lowerExpression(node.a);
+        Operand temp = icg.newTemp();
+        emit(IR_COPY, temp, cond);
+        Operand labelTrue = icg.newLabel();
+        Operand labelFalse = icg.newLabel();
+        emit(IR_BRANCH, labelTrue, temp);
+        emit(IR_JUMP, Operand(), labelFalse);
+        emit(IR_LABEL, Operand(), labelTrue);
+        lowerStatement(node.b);
+        if (node.c != NoNode)
+        {
+            Operand labelEnd = icg.newLabel();
+            emit(IR_JUMP, Operand(), labelEnd);
+            emit(IR_LABEL, Operand(), labelFalse);
+            lowerStatement(node.c);
+            emit(IR_LABEL, Operand(), labelEnd);
+        }
+        else
+        {
+            emit(IR_LABEL, Operand(), labelFalse);
+        }
+    }
+
+    // The parser only accepts break inside a switch or loop
+    void lowerBreak()
+    {
+        if (!breakTargets.empty())
+            emit(IR_JUMP, Operand(), breakTargets.top());
+    }
+
+    // Loop skeleton shared by while and for: L<start>: cond test, body, increment,
+    // jump back. The condition is evaluated again on every iteration.
+    void lowerLoop(NodeId condition, NodeId body, NodeId increment)
+    {
+        Operand labelStart = icg.newLabel();
+        Operand labelEnd = icg.newLabel();
+        Operand labelBody = icg.newLabel();
+        breakTargets.push(labelEnd);
+        emit(IR_LABEL, Operand(), labelStart);
+        Operand cond = lowerExpression(condition);
+        Operand tempCond = icg.newTemp();
+        emit(IR_COPY, tempCond, cond);
+        emit(IR_BRANCH, labelBody, tempCond);
+        emit(IR_JUMP, Operand(), labelEnd);
+        emit(IR_LABEL, Operand(), labelBody);
+        lowerStatement(body);
+        if (increment != NoNode)
+            lowerStatement(increment);
+        emit(IR_JUMP, Operand(), labelStart);
+        emit(IR_LABEL, Operand(), labelEnd);
+        breakTargets.pop();
+    }
+
+    void lowerWhile(const Node &node)
+    {
+        lowerLoop(node.a, node.b, NoNode);
+    }
+
+    void lowerFor(const Node &node)
+    {
+        lowerStatement(node.a);
+        lowerLoop(node.b, node.d, node.c);
+    }
+
+    // The dispatch comes first and jumps to the case bodies, which follow in source
+    // order and fall through into each other unless they break
+    void lowerSwitch(const Node &node)
+    {
+        Operand expr = lowerExpression(node.a);
+
+        Operand switchEndLabel = icg.newLabel();
+        breakTargets.push(switchEndLabel);
+
+        // Case bodies get consecutive labels, so only the first is kept
+        Operand firstBody(OP_LABEL, icg.tempCount);
+        Operand defaultLabel = switchEndLabel;
+        cases.clear();
+        for (NodeId id = node.b; id != NoNode; id = ast[id].next)
+        {
+            const Node &branch = ast[id];
+            Operand bodyLabel = icg.newLabel();
+            int64_t value;
+            if (branch.kind == N_DEFAULT)
+                defaultLabel = bodyLabel;
+            else if (caseValue(branch.a, value))
+                cases.push_back({value, Operand(OP_CONST, branch.a), bodyLabel});
+            else
+                throw runtime_error("Unsupported case label: " + string(symbols.name(branch.a)));
+        }
+        // The first of several cases with the same value wins
+        stable_sort(cases.begin(), cases.end(), [](const SwitchCase &x, const SwitchCase &y)
+                    { return x.value < y.value; });
+        cases.erase(unique(cases.begin(), cases.end(), [](const SwitchCase &x, const SwitchCase &y)
+                           { return x.value == y.value; }),
+                    cases.end());
+
+        if (!cases.empty() &&
+            chooseSwitchStrategy(cases.size(), cases.front().value, cases.back().value) == SWITCH_BINARY_SEARCH)
+            lowerCaseSearch(expr, 0, cases.size(), defaultLabel);
+        else
+            // Also the form MachineCodeGenerator turns into a jump table when the
+            // cases are dense
+            lowerCaseChain(expr, 0, cases.size(), defaultLabel);
+
+        Operand bodyLabel = firstBody;
+        for (NodeId id = node.b; id != NoNode; id = ast[id].next)
+        {
+            emit(IR_LABEL, Operand(), bodyLabel);
+            bodyLabel.id++;
+            lowerStatement(ast[id].b);
+        }
+
+        emit(IR_LABEL, Operand(), switchEndLabel);
+        breakTargets.pop();
+    }
+
+    void lowerCaseChain(Operand expr, size_t first, size_t last, Operand defaultLabel)
+    {
+        for (size_t i = first; i < last; i++)
+            emit(IR_BRANCH_EQ, cases[i].label, expr, cases[i].constant);
+        emit(IR_JUMP, Operand(), defaultLabel);
+    }
+
+    // Splits the sorted cases in half on each compare
+    void lowerCaseSearch(Operand expr, size_t first, size_t last, Operand defaultLabel)
+    {
+        if (last - first <= SwitchLinearMax)
+        {
+            lowerCaseChain(expr, first, last, defaultLabel);
+            return;
+        }
+        size_t middle = first + (last - first) / 2;
+        Operand upperHalf = icg.newLabel();
+        emit(IR_BRANCH_GE, upperHalf, expr, cases[middle].constant);
+        lowerCaseSearch(expr, first, middle, defaultLabel);
+        emit(IR_LABEL, Operand(), upperHalf);
+        lowerCaseSearch(expr, middle, last, defaultLabel);
+    }
+};
+// Instruction selection shared by the code generators: a comparison whose only use
+// is a conditional branch (possibly through copies) is fused into the branch, a
+// branch over an unconditional jump to the label right after it is inverted, and
+// dense switch dispatch is recognised as a jump table.
+class InstructionSelector
+{
+protected:
+    vector<uint32_t> tempUses; // per temporary, in the IR being lowered
+    vector<Operand> table;     // jump table being emitted
+
+    void countTempUses(const vector<IrInstr> &ir)
+    {
+        tempUses.clear();
+        for (const IrInstr &instr : ir)
+            for (Operand operand : {instr.left(), instr.right()})
+                if (operand.kind == OP_TEMP)
+                {
+                    if (operand.id >= tempUses.size())
+                        tempUses.resize(operand.id + 1, 0);
+                    tempUses[operand.id]++;
+                }
+    }
+
+    bool usedOnce(Operand operand) const
+    {
+        return operand.kind == OP_TEMP && operand.id < tempUses.size() && tempUses[operand.id] == 1;
+    }
+
+    static IrOpcode invertedBranch(IrOpcode opcode)
+    {
+        static const IrOpcode inverse[] = {IR_BRANCH_NE, IR_BRANCH_EQ, IR_BRANCH_GE,
+                                           IR_BRANCH_LE, IR_BRANCH_GT, IR_BRANCH_LT};
+        return inverse[opcode - IR_BRANCH_EQ];
+    }
+
+    // The instruction to lower at index i, with the instructions it absorbs folded
+    // in; i is advanced past them
+    IrInstr fuseBranch(const vector<IrInstr> &ir, size_t &i) const
+    {
+        IrInstr instr = ir[i];
+        if (instr.opcode >= IR_EQ && instr.opcode <= IR_GE)
+        {
+            // t1 = a < b; t2 = t1; if t2 goto L  =>  if a < b goto L
+            Operand value = instr.dest();
+            size_t j = i + 1;
+            while (j < ir.size() && usedOnce(value) && ir[j].opcode == IR_COPY && ir[j].left() == value &&
+                   ir[j].dstKind == OP_TEMP)
+                value = ir[j++].dest();
+            if (j == ir.size() || !usedOnce(value) || ir[j].opcode != IR_BRANCH || ir[j].left() != value)
+                return instr;
+            instr = IrInstr(IrOpcode(IR_BRANCH_EQ + (instr.opcode - IR_EQ)), ir[j].dest(), instr.left(), instr.right());
+            i = j;
+        }
+        if (instr.opcode != IR_BRANCH && !isCompareBranch(instr.opcode))
+            return instr;
+
+        // if c goto L1; goto L2; L1:  =>  if !c goto L2; L1:
+        if (i + 2 < ir.size() && ir[i + 1].opcode == IR_JUMP && ir[i + 2].opcode == IR_LABEL &&
+            ir[i + 2].a == instr.dst)
+        {
+            if (instr.opcode == IR_BRANCH)
+                instr = IrInstr(IR_BRANCH_EQ, instr.dest(), instr.left(), Operand(OP_CONST, symbols.intern("0")));
+            else
+                instr.opcode = invertedBranch(instr.opcode);
+            instr.dst = ir[i + 1].a;
+            i++;
+        }
+        return instr;
+    }
+
+    struct JumpTable
+    {
+        Operand selector, defaultLabel;
+        int64_t low;
+        size_t last; // index of the last IR instruction the table replaces
+    };
+
+    // A run of equality branches on one operand followed by the default jump (or
+    // the label reached by falling through), as switch lowering emits it, whose case
+    // values are dense enough for a jump table. On success table holds one label per
+    // value from low up, holes going to the default.
+    bool findJumpTable(const vector<IrInstr> &ir, size_t i, JumpTable &jumpTable)
+    {
+        Operand selector = ir[i].left();
+        size_t j = i;
+        while (j < ir.size() && ir[j].opcode == IR_BRANCH_EQ && ir[j].left() == selector && ir[j].bKind == OP_CONST)
+            j++;
+        if (j - i <= SwitchLinearMax || j == ir.size() || (ir[j].opcode != IR_JUMP && ir[j].opcode != IR_LABEL))
+            return false;
+        Operand defaultLabel(OP_LABEL, ir[j].a);
+
+        int64_t low = INT64_MAX, high = INT64_MIN;
+        for (size_t k = i; k < j; k++)
+        {
+            int64_t value;
+            if (!caseValue(ir[k].b, value))
+                return false;
+            low = min(low, value);
+            high = max(high, value);
+        }
+        if (chooseSwitchStrategy(j - i, low, high) != SWITCH_JUMP_TABLE)
+            return false;
+
+        table.assign(uint64_t(high) - uint64_t(low) + 1, defaultLabel);
+        vector<bool> seen(table.size(), false);
+        for (size_t k = i; k < j; k++)
+        {
+            int64_t value;
+            caseValue(ir[k].b, value);
+            size_t index = uint64_t(value) - uint64_t(low);
+            if (!seen[index]) // the first branch for a value wins
+            {
+                seen[index] = true;
+                table[index] = ir[k].dest();
+            }
+        }
+        jumpTable = {selector, defaultLabel, low, ir[j].opcode == IR_JUMP ? j : j - 1};
+        return true;
+    }
+};
+
+// Machine code generator. Machine instructions are written as text into one
+// preallocated buffer, one entry per IR instruction (an entry may span several
+// lines, e.g. CMP + Jcc).
+class MachineCodeGenerator : public InstructionSelector
+{
+public:
+    // Lowers typed IR directly, dispatching on the opcode. A comparison whose only
+    // use is a conditional branch (possibly through copies) becomes one CMP and a
+    // Jcc, and a branch over an unconditional jump to the label right after it is
+    // inverted so the jump disappears. Dense switch dispatch becomes a jump table.
+    // With a register allocation, temporaries are written as their registers or
+    // stack slots and copies between a register and itself are dropped.
+    void generateMachineCode(const vector<IrInstr> &intermediateCode)
+    {
+        code.reserve(code.size() + intermediateCode.size() * 24);
+        ends.reserve(ends.size() + intermediateCode.size());
+        countTempUses(intermediateCode);
+        for (size_t i = 0; i < intermediateCode.size(); i++)
+        {
+            size_t start = code.size();
+            const IrInstr &instr = intermediateCode[i];
+            try
+            {
+                if (!lowerJumpTable(intermediateCode, i))
+                    lower(fuseBranch(intermediateCode, i));
+            }
+            catch (const runtime_error &e)
+            {
+                code.resize(start);
+                cerr << "Error translating instruction: \"" << irText(instr) << "\"\n"
+                     << e.what() << endl;
+                throw; // Rethrow the exception after logging
+            }
+            if (code.size() > start)
+                endEntry();
+        }
+    }
+
+    // Temporaries are printed where this allocation put them; null prints them as tN
+    void setRegisterAllocation(const RegisterAllocation *registerAllocation)
+    {
+        allocation = registerAllocation;
+    }
+
+    // Compatibility entry point for IR in text form; re-parses every line
+    void generateMachineCode(const vector<string> &intermediateCode)
+    {
+        for (const string &instr : intermediateCode)
+        {
+            try
+            {
+                string mc = translateToMachineCode(instr);
+                if (!mc.empty())
+                {
+                    code += mc;
+                    endEntry();
+                }
+            }
+            catch (const runtime_error &e)
+            {
+                cerr << "Error translating instruction: \"" << instr << "\"\n"
+                     << e.what() << endl;
+                throw; // Rethrow the exception after logging
+            }
+        }
+    }
+
+    // Rewrites the generated code with the peephole rules; returns how many lines they removed
+    size_t optimizePeephole(PeepholeOptimizer &peephole)
+    {
+        return peephole.run(code, ends);
+    }
+
+    size_t instructionCount() const
+    {
+        return ends.size();
+    }
+
+    string_view instruction(size_t index) const
+    {
+        size_t start = index == 0 ? 0 : ends[index - 1] + 1;
+        return string_view(code).substr(start, ends[index] - start);
+    }
+
+    // Print the stored machine instructions
+    void printMachineInstructions() const
+    {
+        cout << code << flush;
+    }
+
+private:
+    string code;          // every entry followed by '\n'
+    vector<size_t> ends;  // offset of each entry's terminating '\n'
+
+    const RegisterAllocation *allocation = nullptr;
+
+    // Dense switch dispatch becomes a bounds-checked jump table:
+    //   CMP x, low / JL Ldefault / CMP x, high / JG Ldefault / JMPTAB x, low, L..., L...
+    bool lowerJumpTable(const vector<IrInstr> &ir, size_t &i)
+    {
+        JumpTable jumpTable;
+        if (!findJumpTable(ir, i, jumpTable))
+            return false;
+        int64_t high = jumpTable.low + int64_t(table.size()) - 1;
+        put("CMP ");
+        put(jumpTable.selector);
+        put(", ");
+        put(to_string(jumpTable.low).c_str());
+        put("\nJL ");
+        put(jumpTable.defaultLabel);
+        put("\nCMP ");
+        put(jumpTable.selector);
+        put(", ");
+        put(to_string(high).c_str());
+        put("\nJG ");
+        put(jumpTable.defaultLabel);
+        put("\nJMPTAB ");
+        put(jumpTable.selector);
+        put(", ");
+        put(to_string(jumpTable.low).c_str());
+        for (Operand entry : table)
+        {
+            put(", ");
+            put(entry);
+        }
+        i = jumpTable.last;
+        return true;
+    }
+
+    void endEntry()
+    {
+        ends.push_back(code.size());
+        code += '\n';
+    }
+
+    void put(const char *text)
+    {
+        code += text;
+    }
+
+    void put(Operand operand)
+    {
+        char digits[16];
+        if (allocation)
+            operand = allocation->locate(operand);
+        switch (operand.kind)
+        {
+        case OP_TEMP:
+        case OP_LABEL:
+        {
+            code += operand.kind == OP_TEMP ? 't' : 'L';
+            char *end = to_chars(digits, digits + sizeof(digits), operand.id).ptr;
+            code.append(digits, end - digits);
+            break;
+        }
+        case OP_SLOT:
+        {
+            code += "[rbp-";
+            char *end = to_chars(digits, digits + sizeof(digits), 8 * (uint64_t(operand.id) + 1)).ptr;
+            code.append(digits, end - digits);
+            code += ']';
+            break;
+        }
+        case OP_STRING:
+            code += '"';
+            code += symbols.name(operand.id);
+            code += '"';
+            break;
+        case OP_NONE:
+            break;
+        default:
+            code += symbols.name(operand.id);
+            break;
+        }
+    }
+
+    // "OP a, b"
+    void put(const char *opcode, Operand a, Operand b)
+    {
+        put(opcode);
+        put(a);
+        put(", ");
+        put(b);
+    }
+
+    void lower(const IrInstr &instr)
+    {
+        static const char *const setcc[] = {"\nSETE ", "\nSETNE ", "\nSETL ", "\nSETG ", "\nSETLE ", "\nSETGE "};
+        static const char *const jcc[] = {"\nJE ", "\nJNE ", "\nJL ", "\nJG ", "\nJLE ", "\nJGE "};
+        switch (instr.opcode)
+        {
+        case IR_COPY:
+            if (allocation && allocation->locate(instr.dest()) == allocation->locate(instr.left()))
+                break; // coalesced
+            put("MOV ", instr.dest(), instr.left());
+            break;
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_DIV:
+        {
+            static const char *const arithmetic[] = {"ADD ", "SUB ", "MUL ", "DIV "};
+            put(arithmetic[instr.opcode - IR_ADD], instr.dest(), instr.left());
+            put(", ");
+            put(instr.right());
+            break;
+        }
+        case IR_EQ:
+        case IR_NE:
+        case IR_LT:
+        case IR_GT:
+        case IR_LE:
+        case IR_GE:
+            // Compare and set destination from the flags
+            put("CMP ", instr.left(), instr.right());
+            put(setcc[instr.opcode - IR_EQ]);
+            put(instr.dest());
+            break;
+        case IR_LABEL:
+            put(instr.left());
+            put(":");
+            break;
+        case IR_JUMP:
+            put("JMP ");
+            put(instr.left());
+            break;
+        case IR_BRANCH:
+            put("CMP ");
+            put(instr.left());
+            put(", 0\nJNE ");
+            put(instr.dest());
+            break;
+        case IR_BRANCH_EQ:
+        case IR_BRANCH_NE:
+        case IR_BRANCH_LT:
+        case IR_BRANCH_GT:
+        case IR_BRANCH_LE:
+        case IR_BRANCH_GE:
+            put("CMP ", instr.left(), instr.right());
+            put(jcc[instr.opcode - IR_BRANCH_EQ]);
+            put(instr.dest());
+            break;
+        case IR_RETURN:
+            put("MOV R0, ");
+            put(instr.left());
+            put("\nRET");
+            break;
+        case IR_FUNC:
+            put("FUNC ");
+            put(instr.left());
+            put(":");
+            break;
+        case IR_END_FUNC:
+            put("END ");
+            put(instr.left());
+            break;
+        default:
+            throw runtime_error("Unsupported operation: " + irText(instr));
+        }
+    }
+
+    // Translates an intermediate code instruction to machine code
+    string translateToMachineCode(const string &intermediateInstr)
+    {
+        vector<string> tokens = split(intermediateInstr, ' ');
+        if (tokens.empty())
+        {
+            return ""; // Return an empty line for invalid or empty input
+        }
+        // Handle labels
+        if (tokens[0].back() == ':')
+        {
+            return tokens[0];
+        }
+        // Handle conditional jumps: if t3 goto L0
+        if (tokens[0] == "if")
+        {
+            // Handle "if var goto label"
+            if (tokens.size() == 4 && tokens[2] == "goto")
+            {
+                // Example: if t3 goto L0
+                return "CMP " + tokens[1] + ", 0\nJNE " + tokens[3];
+            }
+            // Handle "if A op B goto label"
+            else if (tokens.size() == 6 && tokens[4] == "goto")
+            {
+                // Example: if x == 10 goto L12
+                string operand1 = tokens[1];
+                string op = tokens[2];
+                string operand2 = tokens[3];
+                string label = tokens[5];
+                string machineCode;
+                machineCode += "CMP " + operand1 + ", " + operand2 + "\n";
+                if (op == "==")
+                {
+                    machineCode += "JE " + label;
+                }
+                else if (op == "!=")
+                {
+                    machineCode += "JNE " + label;
+                }
+                else if (op == "<")
+                {
+                    machineCode += "JL " + label;
+                }
+                else if (op == "<=")
+                {
+                    machineCode += "JLE " + label;
+                }
+                else if (op == ">")
+                {
+                    machineCode += "JG " + label;
+                }
+                else if (op == ">=")
+                {
+                    machineCode += "JGE " + label;
+                }
+                else
+                {
+                    throw runtime_error("Unsupported comparison operator: " + op);
+                }
+
+                return machineCode;
+            }
+        }
+
+        // Handle unconditional jumps: goto L1
+        if (tokens[0] == "goto")
+        {
+            if (tokens.size() >= 2)
+            {
+                return "JMP " + tokens[1];
+            }
+        }
+        // Handle return statements: return x
+        if (tokens[0] == "return")
+        {
+            if (tokens.size() >= 2)
+            {
+                return "MOV R0, " + tokens[1] + "\nRET";
+            }
+        }
+        // Handle function definitions: FUNC myFunction:
+        if (tokens[0] == "FUNC")
+        {
+            return tokens[0] + " " + tokens[1];
+        }
+        // Handle function ends: END FUNC myFunction
+        if (tokens[0] == "END" && tokens[1] == "FUNC")
+        {
+            return tokens[0] + " " + tokens[2];
+        }
+        // Handle switch statements
+        if (tokens[0] == "SWITCH")
+        {
+            // Example: SWITCH x
+            if (tokens.size() >= 2)
+            {
+                return "SWITCH " + tokens[1];
+            }
+        }
+        // Handle case statements
+        if (tokens[0] == "CASE")
+        {
+            // Example: CASE 10:
+            if (tokens.size() >= 2)
+            {
+                return "CASE " + tokens[1];
+            }
+        }
+        if (tokens[0] == "DEFAULT")
+        {
+            return "DEFAULT";
+        }
+
+        // Handle assignments and arithmetic operations
+        if (tokens[1] == "=")
+        {
+            if (tokens.size() == 3)
+            {
+                // Simple assignment: x = y
+                return "MOV " + tokens[0] + ", " + tokens[2];
+            }
+            else if (tokens.size() == 5)
+            {
+                // Arithmetic or comparison operation: x = y + z or x = y == z
+                string opCode;
+                string operand1 = tokens[2];
+                string operand2 = tokens[4];
+                string destination = tokens[0];
+
+                if (tokens[3] == "+")
+                    opCode = "ADD " + destination + ", " + operand1 + ", " + operand2;
+                else if (tokens[3] == "-")
+                    opCode = "SUB " + destination + ", " + operand1 + ", " + operand2;
+                else if (tokens[3] == "*")
+                    opCode = "MUL " + destination + ", " + operand1 + ", " + operand2;
+                else if (tokens[3] == "/")
+                    opCode = "DIV " + destination + ", " + operand1 + ", " + operand2;
+                else if (tokens[3] == "==")
+                {
+                    // Compare and set destination based on equality
+                    opCode = "CMP " + operand1 + ", " + operand2 + "\nSETE " + destination;
+                }
+                else if (tokens[3] == "!=")
+                {
+                    // Compare and set destination based on inequality
+                    opCode = "CMP " + operand1 + ", " + operand2 + "\nSETNE " + destination;
+                }
+                else if (tokens[3] == "<")
+                {
+                    // Compare and set destination based on less than
+                    opCode = "CMP " + operand1 + ", " + operand2 + "\nSETL " + destination;
+                }
+                else if (tokens[3] == ">")
+                {
+                    // Compare and set destination based on greater than
+                    opCode = "CMP " + operand1 + ", " + operand2 + "\nSETG " + destination;
+                }
+                else if (tokens[3] == "<=")
+                {
+                    // Compare and set destination based on less than or equal
+                    opCode = "CMP " + operand1 + ", " + operand2 + "\nSETLE " + destination;
+                }
+                else if (tokens[3] == ">=")
+                {
+                    // Compare and set destination based on greater than or equal
+                    opCode = "CMP " + operand1 + ", " + operand2 + "\nSETGE " + destination;
+                }
+                else
+                {
+                    throw runtime_error("Unsupported operation: " + tokens[3]);
+                }
+
+                return opCode;
+            }
+        }
+        // Handle break statements (assuming 'JMP L' format)
+        if (tokens[0] == "BREAK")
+        {
+            if (tokens.size() >= 2)
+            {
+                return "JMP " + tokens[1];
+            }
+        }
+        // Handle other unsupported instructions
+        throw runtime_error("Unsupported operation: " + intermediateInstr);
+    }
+
+    // Splits a string into tokens by a delimiter
+    vector<string> split(const string &str, char delimiter)
+    {
+        vector<string> tokens;
+        string token;
+        istringstream tokenStream(str);
+        while (getline(tokenStream, token, delimiter))
+        {
+            if (!token.empty())
+            {
+                tokens.push_back(token);
+            }
+        }
+        return tokens;
+    }
+};
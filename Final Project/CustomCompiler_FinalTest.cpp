@@ -6,6 +6,7 @@
 #include <vector>
 #include <sstream>
 #include <stdexcept>
+#include "TimeReport.h"
 
 using namespace std;
 
@@ -405,6 +406,8 @@ public:
     Parser(const vector<Token> &tokens, SymbolTable &symTable, IntermediateCodeGenerator &icg)
         : tokens(tokens), pos(0), symTable(symTable), icg(icg) {}
 
+    size_t statementCount = 0; // statements parsed so far, for --time-report
+
     void parseProgram()
     {
         while (tokens[pos].type != T_EOF)
@@ -423,6 +426,7 @@ private:
 
     void parseStatement()
     {
+        statementCount++;
         if (isDeclarationStart())
         {
             parseDeclaration();
@@ -1155,8 +1159,20 @@ private:
 };
 
 // Main Function
-int main()
+// Usage: CustomCompiler_FinalTest [--time-report[=text|json]]
+int main(int argc, char *argv[])
 {
+    bool timeReport = false;
+    TimeReport::Format reportFormat = TimeReport::TEXT;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!parseTimeReportOption(argv[i], timeReport, reportFormat))
+        {
+            cerr << "Usage: " << argv[0] << " [--time-report[=text|json]]" << endl;
+            return 1;
+        }
+    }
+
     string sourceCode = R"(
       int a;
       a = 5;
@@ -1194,12 +1210,22 @@ int main()
       }
     )";
 
+    TimeReport report;
+    report.begin("lexing");
     Lexer lexer(sourceCode);
     vector<Token> tokenList = lexer.tokenize();
+    report.end();
+    report.count("tokens", tokenList.size());
+
     SymbolTable symbolTable;
     IntermediateCodeGenerator codeGen;
+    // Intermediate code is emitted while parsing, so the two share a phase
+    report.begin("parsing+IR");
     Parser parser(tokenList, symbolTable, codeGen);
     parser.parseProgram();
+    report.end();
+    report.count("statements", parser.statementCount);
+    report.count("IR instructions", codeGen.instructions.size());
 
     cout << "Generated Intermediate Code:" << endl;
     codeGen.printInstructions();
@@ -1207,7 +1233,10 @@ int main()
     try
     {
         MachineCodeGenerator machineGen;
+        report.begin("machine code");
         machineGen.generateMachineCode(codeGen.getInstructionsAsVector());
+        report.end();
+        report.count("machine instructions", machineGen.machineInstructions.size());
         cout << "\nGenerated Machine Code:" << endl;
         machineGen.printMachineInstructions();
     }
@@ -1217,5 +1246,7 @@ int main()
         return 1;
     }
 
+    if (timeReport)
+        report.print(cerr, reportFormat);
     return 0;
 }
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "Interner.h"
+using namespace std;
+
+// Three-address intermediate representation.
+//
+// Instructions are fixed-size 16-byte records stored contiguously: an opcode, the
+// kinds of up to three operands and their 32-bit ids. Temporaries and labels are
+// numbered from the same counter; variables, constants and strings refer to
+// interned symbols. Text is produced only when the IR is printed.
+
+enum IrOpcode : uint8_t
+{
+    IR_COPY, // dst = a
+
+    // dst = a op b
+    IR_ADD,
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_EQ,
+    IR_NE,
+    IR_LT,
+    IR_GT,
+    IR_LE,
+    IR_GE,
+
+    IR_LABEL,  // a:
+    IR_JUMP,   // goto a
+    IR_BRANCH, // if a goto dst
+
+    // if a op b goto dst
+    IR_BRANCH_EQ,
+    IR_BRANCH_NE,
+    IR_BRANCH_LT,
+    IR_BRANCH_GT,
+    IR_BRANCH_LE,
+    IR_BRANCH_GE,
+
+    IR_RETURN,   // return a
+    IR_FUNC,     // FUNC a:
+    IR_END_FUNC, // END FUNC a
+    IR_PHI,      // dst = phi(...), only in SSA form; SsaForm holds the operands
+    IR_OPCODE_COUNT
+};
+
+enum OperandKind : uint8_t
+{
+    OP_NONE,
+    OP_TEMP,   // id: temporary number (tN)
+    OP_VAR,    // id: symbol of a variable or member path
+    OP_CONST,  // id: symbol of a number or true/false literal
+    OP_STRING, // id: symbol of the decoded string value
+    OP_LABEL,  // id: label number (LN)
+    OP_FUNC,   // id: symbol of a function name
+    OP_REG,    // id: symbol of a machine register, only in register allocations
+    OP_SLOT    // id: stack slot number, only in register allocations
+};
+
+struct Operand
+{
+    OperandKind kind = OP_NONE;
+    uint32_t id = 0;
+
+    Operand() = default;
+    Operand(OperandKind kind, uint32_t id) : kind(kind), id(id) {}
+
+    bool operator==(const Operand &other) const
+    {
+        return kind == other.kind && id == other.id;
+    }
+    bool operator!=(const Operand &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+struct IrInstr
+{
+    IrOpcode opcode;
+    OperandKind dstKind, aKind, bKind;
+    uint32_t dst, a, b;
+
+    IrInstr(IrOpcode opcode, Operand dstOperand = Operand(), Operand aOperand = Operand(), Operand bOperand = Operand())
+        : opcode(opcode), dstKind(dstOperand.kind), aKind(aOperand.kind), bKind(bOperand.kind),
+          dst(dstOperand.id), a(aOperand.id), b(bOperand.id) {}
+
+    Operand dest() const
+    {
+        return Operand(dstKind, dst);
+    }
+    Operand left() const
+    {
+        return Operand(aKind, a);
+    }
+    Operand right() const
+    {
+        return Operand(bKind, b);
+    }
+
+    void setDest(Operand operand)
+    {
+        dstKind = operand.kind;
+        dst = operand.id;
+    }
+    void setLeft(Operand operand)
+    {
+        aKind = operand.kind;
+        a = operand.id;
+    }
+    void setRight(Operand operand)
+    {
+        bKind = operand.kind;
+        b = operand.id;
+    }
+};
+
+static_assert(sizeof(IrInstr) == 16, "IR instructions should stay 16 bytes");
+
+inline bool isBinaryOpcode(IrOpcode opcode)
+{
+    return opcode >= IR_ADD && opcode <= IR_GE;
+}
+
+inline bool isCompareBranch(IrOpcode opcode)
+{
+    return opcode >= IR_BRANCH_EQ && opcode <= IR_BRANCH_GE;
+}
+
+// Copies and binary operations assign their destination; phis are handled apart
+inline bool writesDest(IrOpcode opcode)
+{
+    return opcode == IR_COPY || isBinaryOpcode(opcode);
+}
+
+// Source spelling of the operator of a binary or compare-and-branch opcode
+inline const char *irOperatorText(IrOpcode opcode)
+{
+    static const char *const text[] = {"==", "!=", "<", ">", "<=", ">="};
+    switch (opcode)
+    {
+    case IR_ADD:
+        return "+";
+    case IR_SUB:
+        return "-";
+    case IR_MUL:
+        return "*";
+    case IR_DIV:
+        return "/";
+    default:
+        if (opcode >= IR_EQ && opcode <= IR_GE)
+            return text[opcode - IR_EQ];
+        if (isCompareBranch(opcode))
+            return text[opcode - IR_BRANCH_EQ];
+        return "?";
+    }
+}
+
+inline string operandText(Operand operand)
+{
+    switch (operand.kind)
+    {
+    case OP_TEMP:
+        return "t" + to_string(operand.id);
+    case OP_LABEL:
+        return "L" + to_string(operand.id);
+    case OP_SLOT:
+        return "[rbp-" + to_string(8 * (operand.id + 1)) + "]";
+    case OP_STRING:
+        return "\"" + string(symbols.name(operand.id)) + "\"";
+    case OP_VAR:
+    case OP_CONST:
+    case OP_FUNC:
+    case OP_REG:
+        return string(symbols.name(operand.id));
+    default:
+        return "";
+    }
+}
+
+// The textual form the IR has always been printed in, e.g. "t3 = a + 1"
+inline string irText(const IrInstr &instr)
+{
+    switch (instr.opcode)
+    {
+    case IR_COPY:
+        return operandText(instr.dest()) + " = " + operandText(instr.left());
+    case IR_LABEL:
+        return operandText(instr.left()) + ":";
+    case IR_JUMP:
+        return "goto " + operandText(instr.left());
+    case IR_BRANCH:
+        return "if " + operandText(instr.left()) + " goto " + operandText(instr.dest());
+    case IR_RETURN:
+        return "return " + operandText(instr.left());
+    case IR_FUNC:
+        return "FUNC " + operandText(instr.left()) + ":";
+    case IR_END_FUNC:
+        return "END FUNC " + operandText(instr.left());
+    case IR_PHI:
+        return operandText(instr.dest()) + " = phi";
+    default:
+        if (isBinaryOpcode(instr.opcode))
+            return operandText(instr.dest()) + " = " + operandText(instr.left()) + " " +
+                   irOperatorText(instr.opcode) + " " + operandText(instr.right());
+        if (isCompareBranch(instr.opcode))
+            return "if " + operandText(instr.left()) + " " + irOperatorText(instr.opcode) + " " +
+                   operandText(instr.right()) + " goto " + operandText(instr.dest());
+        return "";
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+using namespace std;
+
+typedef uint32_t SymbolId;
+const SymbolId NoSymbol = 0xFFFFFFFFu;
+
+// Interns names into dense 32-bit ids. Each distinct name is stored once, so later
+// phases compare and look up identifiers as integers and memory grows with the
+// number of distinct names rather than the number of occurrences.
+class StringInterner
+{
+public:
+    StringInterner() : slots(1024, NoSymbol) {}
+
+    SymbolId intern(string_view name)
+    {
+        uint32_t h = hash(name);
+        size_t mask = slots.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask)
+        {
+            SymbolId id = slots[i];
+            if (id == NoSymbol)
+            {
+                id = (SymbolId)names.size();
+                names.push_back(store(name));
+                hashes.push_back(h);
+                slots[i] = id;
+                if (names.size() * 2 > slots.size())
+                    grow();
+                return id;
+            }
+            if (hashes[id] == h && names[id] == name)
+                return id;
+        }
+    }
+
+    // Id of `name` if it has been interned, NoSymbol otherwise
+    SymbolId find(string_view name) const
+    {
+        uint32_t h = hash(name);
+        size_t mask = slots.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask)
+        {
+            SymbolId id = slots[i];
+            if (id == NoSymbol || (hashes[id] == h && names[id] == name))
+                return id;
+        }
+    }
+
+    string_view name(SymbolId id) const
+    {
+        return names[id];
+    }
+
+    size_t size() const
+    {
+        return names.size();
+    }
+
+private:
+    static const size_t BlockSize = 64 * 1024;
+
+    vector<string_view> names; // id -> name, pointing into `blocks`
+    vector<uint32_t> hashes;   // id -> hash, so rehashing never touches the text
+    vector<SymbolId> slots;    // open-addressed hash table of ids
+    vector<unique_ptr<char[]>> blocks;
+    size_t blockUsed = BlockSize;
+
+    static uint32_t hash(string_view name)
+    {
+        uint32_t h = 2166136261u; // FNV-1a
+        for (char c : name)
+            h = (h ^ (unsigned char)c) * 16777619u;
+        return h;
+    }
+
+    // Copies the name into block storage that never moves
+    string_view store(string_view name)
+    {
+        if (name.size() > BlockSize)
+        {
+            // Oversized names get their own block, kept out of the way of the current one
+            char *out = new char[name.size()];
+            blocks.emplace(blocks.begin(), out);
+            memcpy(out, name.data(), name.size());
+            return string_view(out, name.size());
+        }
+        if (blockUsed + name.size() > BlockSize)
+        {
+            blocks.emplace_back(new char[BlockSize]);
+            blockUsed = 0;
+        }
+        char *out = blocks.back().get() + blockUsed;
+        memcpy(out, name.data(), name.size());
+        blockUsed += name.size();
+        return string_view(out, name.size());
+    }
+
+    void grow()
+    {
+        vector<SymbolId> bigger(slots.size() * 2, NoSymbol);
+        size_t mask = bigger.size() - 1;
+        for (SymbolId id = 0; id < names.size(); id++)
+        {
+            size_t i = hashes[id] & mask;
+            while (bigger[i] != NoSymbol)
+                i = (i + 1) & mask;
+            bigger[i] = id;
+        }
+        slots.swap(bigger);
+    }
+};
+
+// The one intern table shared by every phase of the compiler
+inline StringInterner symbols;
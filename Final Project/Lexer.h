@@ -0,0 +1,455 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include "../LexScan.h"
+#include "../SourceBuffer.h"
+#include "../KeywordHash.h"
+#include "../TokenStream.h"
+#include "Interner.h"
+using namespace std;
+
+enum TokenType
+{
+    T_INT,
+    T_ID,
+    T_NUM,
+    T_IF,
+    T_ELSE,
+    T_RETURN,
+    T_ASSIGN,
+    T_PLUS,
+    T_MINUS,
+    T_MUL,
+    T_DIV,
+    T_LPAREN,
+    T_RPAREN,
+    T_LBRACE,
+    T_RBRACE,
+    T_SEMICOLON,
+    T_GT,
+    T_LT,
+    T_EQ,
+    T_NEQ,
+    T_GTE,
+    T_LTE,
+    T_WHILE,
+    T_FUNC,
+    T_SWITCH,
+    T_CASE,
+    T_DEFAULT,
+    T_BREAK,
+    T_BOOL,
+    T_TRUE,
+    T_FALSE,
+    T_STRING,
+    T_COMMENT,
+    T_COLON,
+    T_FOR,
+    T_STRUCT,
+    T_CLASS,
+    T_ARRAY,
+    T_LBRACKET,
+    T_RBRACKET,
+    T_DOT,
+    T_STRING_TYPE,
+    T_EOF
+};
+
+// Token values are views into the SourceBuffer the lexer ran over.
+// Identifiers also carry their interned symbol id.
+struct Token
+{
+    string_view value;
+    TokenType type = T_EOF;
+    int lineNumber = 0;
+    SymbolId symbol = NoSymbol;
+
+    Token() = default;
+    Token(TokenType type, string_view value, int lineNumber, SymbolId symbol = NoSymbol)
+        : value(value), type(type), lineNumber(lineNumber), symbol(symbol) {}
+};
+
+// Character classes seen by the lexer DFA
+enum CharClass : uint8_t
+{
+    C_OTHER,
+    C_SPACE,
+    C_NEWLINE,
+    C_DIGIT,
+    C_ALPHA,
+    C_QUOTE,
+    C_EQUAL,
+    C_BANG,
+    C_LESS,
+    C_GREATER,
+    C_PLUS,
+    C_MINUS,
+    C_STAR,
+    C_SLASH,
+    C_LPAREN,
+    C_RPAREN,
+    C_LBRACE,
+    C_RBRACE,
+    C_SEMICOLON,
+    C_COLON,
+    C_LBRACKET,
+    C_RBRACKET,
+    C_DOT,
+    C_COUNT
+};
+
+// DFA states. Every state except S_START, S_DEAD and S_ERROR accepts a lexeme.
+enum LexState : uint8_t
+{
+    S_START,
+    S_SPACE,
+    S_NUMBER,
+    S_WORD,
+    S_STRING, // handed over to consumeString() for escape decoding
+    S_ASSIGN,
+    S_EQ,
+    S_BANG,
+    S_NEQ,
+    S_LT,
+    S_LTE,
+    S_GT,
+    S_GTE,
+    S_PLUS,
+    S_MINUS,
+    S_MUL,
+    S_DIV,
+    S_LPAREN,
+    S_RPAREN,
+    S_LBRACE,
+    S_RBRACE,
+    S_SEMICOLON,
+    S_COLON,
+    S_LBRACKET,
+    S_RBRACKET,
+    S_DOT,
+    S_ERROR,
+    S_DEAD,
+    S_COUNT
+};
+
+struct LexTables
+{
+    array<uint8_t, 256> charClass;
+    array<array<uint8_t, C_COUNT>, S_COUNT> next;
+    array<TokenType, S_COUNT> accept;
+};
+
+constexpr LexTables buildLexTables()
+{
+    LexTables t{};
+
+    // Character classes (ASCII only, matching isspace/isdigit/isalpha in the C locale)
+    for (int c = 0; c < 256; c++)
+        t.charClass[c] = C_OTHER;
+    t.charClass[' '] = t.charClass['\t'] = t.charClass['\v'] = t.charClass['\f'] = t.charClass['\r'] = C_SPACE;
+    t.charClass['\n'] = C_NEWLINE;
+    for (int c = '0'; c <= '9'; c++)
+        t.charClass[c] = C_DIGIT;
+    for (int c = 'a'; c <= 'z'; c++)
+        t.charClass[c] = C_ALPHA;
+    for (int c = 'A'; c <= 'Z'; c++)
+        t.charClass[c] = C_ALPHA;
+    t.charClass['_'] = C_ALPHA;
+    t.charClass['"'] = C_QUOTE;
+    t.charClass['='] = C_EQUAL;
+    t.charClass['!'] = C_BANG;
+    t.charClass['<'] = C_LESS;
+    t.charClass['>'] = C_GREATER;
+    t.charClass['+'] = C_PLUS;
+    t.charClass['-'] = C_MINUS;
+    t.charClass['*'] = C_STAR;
+    t.charClass['/'] = C_SLASH;
+    t.charClass['('] = C_LPAREN;
+    t.charClass[')'] = C_RPAREN;
+    t.charClass['{'] = C_LBRACE;
+    t.charClass['}'] = C_RBRACE;
+    t.charClass[';'] = C_SEMICOLON;
+    t.charClass[':'] = C_COLON;
+    t.charClass['['] = C_LBRACKET;
+    t.charClass[']'] = C_RBRACKET;
+    t.charClass['.'] = C_DOT;
+
+    // Transitions: anything not listed ends the current lexeme
+    for (int s = 0; s < S_COUNT; s++)
+        for (int c = 0; c < C_COUNT; c++)
+            t.next[s][c] = S_DEAD;
+
+    t.next[S_START][C_OTHER] = S_ERROR;
+    t.next[S_START][C_SPACE] = S_SPACE;
+    t.next[S_START][C_NEWLINE] = S_SPACE;
+    t.next[S_START][C_DIGIT] = S_NUMBER;
+    t.next[S_START][C_ALPHA] = S_WORD;
+    t.next[S_START][C_QUOTE] = S_STRING;
+    t.next[S_START][C_EQUAL] = S_ASSIGN;
+    t.next[S_START][C_BANG] = S_BANG;
+    t.next[S_START][C_LESS] = S_LT;
+    t.next[S_START][C_GREATER] = S_GT;
+    t.next[S_START][C_PLUS] = S_PLUS;
+    t.next[S_START][C_MINUS] = S_MINUS;
+    t.next[S_START][C_STAR] = S_MUL;
+    t.next[S_START][C_SLASH] = S_DIV;
+    t.next[S_START][C_LPAREN] = S_LPAREN;
+    t.next[S_START][C_RPAREN] = S_RPAREN;
+    t.next[S_START][C_LBRACE] = S_LBRACE;
+    t.next[S_START][C_RBRACE] = S_RBRACE;
+    t.next[S_START][C_SEMICOLON] = S_SEMICOLON;
+    t.next[S_START][C_COLON] = S_COLON;
+    t.next[S_START][C_LBRACKET] = S_LBRACKET;
+    t.next[S_START][C_RBRACKET] = S_RBRACKET;
+    t.next[S_START][C_DOT] = S_DOT;
+
+    t.next[S_SPACE][C_SPACE] = S_SPACE;
+    t.next[S_SPACE][C_NEWLINE] = S_SPACE;
+    t.next[S_NUMBER][C_DIGIT] = S_NUMBER;
+    t.next[S_WORD][C_ALPHA] = S_WORD;
+    t.next[S_WORD][C_DIGIT] = S_WORD;
+
+    // Two-character operators
+    t.next[S_ASSIGN][C_EQUAL] = S_EQ;
+    t.next[S_BANG][C_EQUAL] = S_NEQ;
+    t.next[S_LT][C_EQUAL] = S_LTE;
+    t.next[S_GT][C_EQUAL] = S_GTE;
+
+    // Token produced when the DFA stops in a state
+    for (int s = 0; s < S_COUNT; s++)
+        t.accept[s] = T_EOF;
+    t.accept[S_NUMBER] = T_NUM;
+    t.accept[S_WORD] = T_ID;
+    t.accept[S_STRING] = T_STRING;
+    t.accept[S_ASSIGN] = T_ASSIGN;
+    t.accept[S_EQ] = T_EQ;
+    t.accept[S_BANG] = T_ASSIGN; // a lone '!' has always been reported as T_ASSIGN
+    t.accept[S_NEQ] = T_NEQ;
+    t.accept[S_LT] = T_LT;
+    t.accept[S_LTE] = T_LTE;
+    t.accept[S_GT] = T_GT;
+    t.accept[S_GTE] = T_GTE;
+    t.accept[S_PLUS] = T_PLUS;
+    t.accept[S_MINUS] = T_MINUS;
+    t.accept[S_MUL] = T_MUL;
+    t.accept[S_DIV] = T_DIV;
+    t.accept[S_LPAREN] = T_LPAREN;
+    t.accept[S_RPAREN] = T_RPAREN;
+    t.accept[S_LBRACE] = T_LBRACE;
+    t.accept[S_RBRACE] = T_RBRACE;
+    t.accept[S_SEMICOLON] = T_SEMICOLON;
+    t.accept[S_COLON] = T_COLON;
+    t.accept[S_LBRACKET] = T_LBRACKET;
+    t.accept[S_RBRACKET] = T_RBRACKET;
+    t.accept[S_DOT] = T_DOT;
+    return t;
+}
+
+constexpr LexTables lexTables = buildLexTables();
+
+// Reserved words, recognised with a compile-time perfect hash
+constexpr auto keywordTable = makeKeywordTable<TokenType>(
+    {
+        {"int", T_INT},
+        {"if", T_IF},
+        {"else", T_ELSE},
+        {"return", T_RETURN},
+        {"while", T_WHILE},
+        {"func", T_FUNC},
+        {"switch", T_SWITCH},
+        {"case", T_CASE},
+        {"default", T_DEFAULT},
+        {"bool", T_BOOL},
+        {"true", T_TRUE},
+        {"false", T_FALSE},
+        {"for", T_FOR},
+        {"struct", T_STRUCT},
+        {"class", T_CLASS},
+        {"array", T_ARRAY},
+        {"string", T_STRING_TYPE},
+        {"break", T_BREAK},
+    },
+    T_ID);
+
+// Lexer Class. Tokens are produced on demand by nextToken(); tokenize() collects them all.
+class Lexer : public TokenSource<Token>
+{
+private:
+    SourceBuffer &source;
+    string_view src;
+    size_t pos;
+    size_t limit; // no token starts at or after this offset
+    int lineNumber;
+    StringInterner &names;
+
+public:
+    Lexer(SourceBuffer &source) : source(source), src(source.text()), pos(0), limit(src.size()), lineNumber(1), names(symbols) {}
+
+    // Lexes only the tokens starting in [begin, limit), with `line` being the line at `begin`.
+    // Used by tokenizeParallel(); errors are recorded instead of ending the program.
+    Lexer(SourceBuffer &source, size_t begin, size_t limit, int line, StringInterner &names)
+        : source(source), src(source.text()), pos(begin), limit(limit), lineNumber(line), names(names), deferErrors(true) {}
+
+    Token nextToken() override;
+    vector<Token> tokenize();
+
+    bool deferErrors = false;
+    string errorMessage; // first error seen when deferErrors is set
+    int errorLine = 0;
+
+private:
+    string_view consumeString();
+    TokenType identifyKeyword(string_view word);
+    void error(const string &message);
+};
+
+inline Token Lexer::nextToken()
+{
+    const char *text = src.data();
+    const size_t size = src.size();
+    const lexscan::Kernels &scan = lexscan::kernels;
+    while (pos < limit)
+    {
+        size_t start = pos;
+        uint8_t state = lexTables.next[S_START][lexTables.charClass[(unsigned char)text[pos]]];
+
+        // Whitespace, words and numbers are extended in bulk by the SIMD kernels
+        switch (state)
+        {
+        case S_SPACE:
+            pos = scan.skipSpace(text, pos, size, lineNumber);
+            continue;
+        case S_WORD:
+        {
+            pos = scan.skipIdentifier(text, pos + 1, size);
+            string_view word = src.substr(start, pos - start);
+            TokenType type = identifyKeyword(word);
+            return Token{type, word, lineNumber, type == T_ID ? names.intern(word) : NoSymbol};
+        }
+        case S_NUMBER:
+            pos = scan.skipDigits(text, pos + 1, size);
+            return Token{T_NUM, src.substr(start, pos - start), lineNumber};
+        case S_STRING:
+        {
+            int line = lineNumber; // literals may span lines; report where they start
+            return Token{T_STRING, consumeString(), line};
+        }
+        case S_ERROR:
+            error("Unexpected character");
+            continue;
+        }
+
+        // Operators: follow the DFA while a longer operator is possible
+        pos++;
+        while (pos < size)
+        {
+            uint8_t next = lexTables.next[state][lexTables.charClass[(unsigned char)text[pos]]];
+            if (next == S_DEAD)
+                break;
+            state = next;
+            pos++;
+        }
+        return Token{lexTables.accept[state], src.substr(start, pos - start), lineNumber};
+    }
+    return Token{T_EOF, "", lineNumber};
+}
+
+inline vector<Token> Lexer::tokenize()
+{
+    vector<Token> tokens;
+    do
+    {
+        tokens.push_back(nextToken());
+    } while (tokens.back().type != T_EOF);
+    return tokens;
+}
+
+inline string_view Lexer::consumeString()
+{
+    const char *text = src.data();
+    size_t start = ++pos; // Skip opening quote
+    string decoded;       // only filled once an escape sequence is seen
+    bool hasEscapes = false;
+    while (true)
+    {
+        // Jump to the next quote, backslash or newline in one go
+        size_t stop = lexscan::kernels.findStringStop(text, pos, src.size());
+        if (hasEscapes)
+            decoded.append(text + pos, stop - pos);
+        pos = stop;
+        if (pos >= src.size() || src[pos] == '"')
+            break;
+        if (src[pos] == '\\' && pos + 1 < src.size())
+        {
+            if (!hasEscapes)
+            {
+                decoded.assign(text + start, pos - start);
+                hasEscapes = true;
+            }
+            // Handle escape characters
+            pos++;
+            char escape = src[pos];
+            switch (escape)
+            {
+            case 'n':
+                decoded += '\n';
+                break;
+            case 't':
+                decoded += '\t';
+                break;
+            case '\\':
+                decoded += '\\';
+                break;
+            case '"':
+                decoded += '"';
+                break;
+            default:
+                decoded += escape;
+                break;
+            }
+        }
+        else
+        {
+            if (src[pos] == '\n')
+                lineNumber++;
+            if (hasEscapes)
+                decoded += src[pos];
+        }
+        pos++;
+    }
+    if (pos >= src.size())
+    {
+        error("Unterminated string literal");
+    }
+    size_t end = pos++; // Skip closing quote
+    if (!hasEscapes)
+        return src.substr(start, end - start);
+    return source.storeDecoded(std::move(decoded));
+}
+
+inline TokenType Lexer::identifyKeyword(string_view word)
+{
+    return keywordTable.lookup(word);
+}
+
+inline void Lexer::error(const string &message)
+{
+    if (deferErrors)
+    {
+        if (errorMessage.empty())
+        {
+            errorMessage = message;
+            errorLine = lineNumber;
+        }
+        pos = limit = src.size(); // stop lexing this range
+        return;
+    }
+    cout << "Lexical error at line " << lineNumber << ": " << message << endl;
+    exit(1);
+}
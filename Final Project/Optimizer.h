@@ -0,0 +1,1383 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "CFG.h"
+#include "IR.h"
+#include "SSA.h"
+using namespace std;
+
+// Optimization passes over the typed IR, run between IntermediateCodeGenerator
+// and MachineCodeGenerator. Each pass rewrites the instruction vector in place
+// and returns how many instructions it removed.
+
+// Integer value of a constant operand. Booleans count as 1/0 only when
+// `allowBool` is set (branch conditions); text that is not a number that fits in
+// 64 bits is not treated as known.
+inline bool constantValue(Operand operand, int64_t &value, bool allowBool = false)
+{
+    if (operand.kind != OP_CONST)
+        return false;
+    string_view text = symbols.name(operand.id);
+    if (text == "true" || text == "false")
+    {
+        value = text == "true";
+        return allowBool;
+    }
+    if (text.empty() || text.size() > 18)
+        return false;
+    bool negative = text[0] == '-' && text.size() > 1;
+    int64_t result = 0;
+    for (size_t i = negative; i < text.size(); i++)
+    {
+        if (text[i] < '0' || text[i] > '9')
+            return false;
+        result = result * 10 + (text[i] - '0');
+    }
+    value = negative ? -result : result;
+    return true;
+}
+
+inline Operand constantOperand(int64_t value)
+{
+    return Operand(OP_CONST, symbols.intern(to_string(value)));
+}
+
+// Evaluates a binary or compare opcode; false if it cannot be folded (division by zero)
+inline bool evaluate(IrOpcode opcode, int64_t left, int64_t right, int64_t &result)
+{
+    // Wrap like the target's two's complement arithmetic instead of overflowing
+    uint64_t l = (uint64_t)left, r = (uint64_t)right;
+    switch (opcode)
+    {
+    case IR_ADD:
+        result = (int64_t)(l + r);
+        return true;
+    case IR_SUB:
+        result = (int64_t)(l - r);
+        return true;
+    case IR_MUL:
+        result = (int64_t)(l * r);
+        return true;
+    case IR_DIV:
+        if (right == 0 || (left == INT64_MIN && right == -1))
+            return false;
+        result = left / right;
+        return true;
+    case IR_EQ:
+    case IR_BRANCH_EQ:
+        result = left == right;
+        return true;
+    case IR_NE:
+    case IR_BRANCH_NE:
+        result = left != right;
+        return true;
+    case IR_LT:
+    case IR_BRANCH_LT:
+        result = left < right;
+        return true;
+    case IR_GT:
+    case IR_BRANCH_GT:
+        result = left > right;
+        return true;
+    case IR_LE:
+    case IR_BRANCH_LE:
+        result = left <= right;
+        return true;
+    case IR_GE:
+    case IR_BRANCH_GE:
+        result = left >= right;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Constant folding, constant propagation and algebraic simplification.
+//
+// Temporaries are assigned exactly once, so a temporary with a constant value is
+// constant everywhere. Variables are tracked only until the next label or function
+// boundary. Branches on known conditions become jumps or disappear, and
+// definitions of constant temporaries that are no longer read are dropped.
+class ConstantFolder
+{
+public:
+    size_t run(vector<IrInstr> &code)
+    {
+        size_t before = code.size();
+        uint32_t temps = 0;
+        for (const IrInstr &instr : code)
+            if (instr.dstKind == OP_TEMP && instr.dst >= temps)
+                temps = instr.dst + 1;
+        tempKnown.assign(temps, false);
+        tempValue.assign(temps, Operand());
+        varStamp.assign(symbols.size(), 0);
+        varValue.assign(symbols.size(), Operand());
+        stamp = 1;
+
+        vector<bool> removed(code.size(), false);
+        for (size_t i = 0; i < code.size(); i++)
+            removed[i] = !fold(code[i]);
+
+        // Drop constant temporaries nobody reads any more
+        vector<uint32_t> uses(tempKnown.size(), 0);
+        for (size_t i = 0; i < code.size(); i++)
+        {
+            if (removed[i])
+                continue;
+            countUse(code[i].left(), uses);
+            countUse(code[i].right(), uses);
+        }
+        size_t out = 0;
+        for (size_t i = 0; i < code.size(); i++)
+        {
+            Operand dest = code[i].dest();
+            bool deadConstant = dest.kind == OP_TEMP && (code[i].opcode == IR_COPY || isBinaryOpcode(code[i].opcode)) &&
+                                isKnownTemp(dest.id) && uses[dest.id] == 0;
+            if (!removed[i] && !deadConstant)
+                code[out++] = code[i];
+        }
+        code.erase(code.begin() + out, code.end());
+        return before - out;
+    }
+
+private:
+    // Known values are kept as constant operands, so propagating one does not intern
+    vector<bool> tempKnown;
+    vector<Operand> tempValue;
+    vector<uint32_t> varStamp; // a variable's value is known while its stamp is current
+    vector<Operand> varValue;
+    uint32_t stamp = 1;
+
+    bool isKnownTemp(uint32_t id) const
+    {
+        return id < tempKnown.size() && tempKnown[id];
+    }
+
+    static void countUse(Operand operand, vector<uint32_t> &uses)
+    {
+        if (operand.kind == OP_TEMP && operand.id < uses.size())
+            uses[operand.id]++;
+    }
+
+    // Replaces a temporary or variable with its value when it is known
+    Operand propagate(Operand operand) const
+    {
+        if (operand.kind == OP_TEMP && isKnownTemp(operand.id))
+            return tempValue[operand.id];
+        if (operand.kind == OP_VAR && operand.id < varStamp.size() && varStamp[operand.id] == stamp)
+            return varValue[operand.id];
+        return operand;
+    }
+
+    void record(Operand dest, Operand value)
+    {
+        int64_t number;
+        bool known = constantValue(value, number); // booleans are not propagated
+        if (dest.kind == OP_TEMP)
+        {
+            tempKnown[dest.id] = known;
+            tempValue[dest.id] = value;
+        }
+        else if (dest.kind == OP_VAR)
+        {
+            varStamp[dest.id] = known ? stamp : 0;
+            varValue[dest.id] = value;
+        }
+    }
+
+    // Rewrites one instruction; returns false if it should be deleted
+    bool fold(IrInstr &instr)
+    {
+        switch (instr.opcode)
+        {
+        case IR_LABEL:
+        case IR_FUNC:
+        case IR_END_FUNC:
+            stamp++; // control can arrive from elsewhere
+            return true;
+        case IR_COPY:
+            instr.setLeft(propagate(instr.left()));
+            record(instr.dest(), instr.left());
+            return true;
+        case IR_RETURN:
+            instr.setLeft(propagate(instr.left()));
+            return true;
+        case IR_BRANCH:
+        {
+            instr.setLeft(propagate(instr.left()));
+            int64_t condition;
+            if (!constantValue(instr.left(), condition, true))
+                return true;
+            return takeBranch(instr, condition != 0);
+        }
+        default:
+            break;
+        }
+
+        if (isCompareBranch(instr.opcode))
+        {
+            instr.setLeft(propagate(instr.left()));
+            instr.setRight(propagate(instr.right()));
+            int64_t left, right, result;
+            if (constantValue(instr.left(), left) && constantValue(instr.right(), right) &&
+                evaluate(instr.opcode, left, right, result))
+                return takeBranch(instr, result != 0);
+            return true;
+        }
+
+        if (isBinaryOpcode(instr.opcode))
+        {
+            instr.setLeft(propagate(instr.left()));
+            instr.setRight(propagate(instr.right()));
+            simplify(instr);
+            record(instr.dest(), instr.opcode == IR_COPY ? instr.left() : Operand());
+        }
+        return true;
+    }
+
+    // A branch with a known outcome becomes a jump or is deleted
+    static bool takeBranch(IrInstr &instr, bool taken)
+    {
+        if (!taken)
+            return false;
+        instr = IrInstr(IR_JUMP, Operand(), instr.dest());
+        return true;
+    }
+
+    static void becomeCopy(IrInstr &instr, Operand value)
+    {
+        instr = IrInstr(IR_COPY, instr.dest(), value);
+    }
+
+    // Folds constant operands and applies identities; true if the instruction changed
+    static bool simplify(IrInstr &instr)
+    {
+        Operand a = instr.left(), b = instr.right();
+        int64_t left = 0, right = 0, result;
+        bool leftKnown = constantValue(a, left);
+        bool rightKnown = constantValue(b, right);
+        if (leftKnown && rightKnown)
+        {
+            if (!evaluate(instr.opcode, left, right, result))
+                return false;
+            becomeCopy(instr, constantOperand(result));
+            return true;
+        }
+
+        bool numeric = a.kind != OP_STRING && b.kind != OP_STRING;
+        switch (instr.opcode)
+        {
+        case IR_ADD:
+            if (rightKnown && right == 0 && numeric)
+                return becomeCopy(instr, a), true;
+            if (leftKnown && left == 0 && numeric)
+                return becomeCopy(instr, b), true;
+            break;
+        case IR_SUB:
+            if (rightKnown && right == 0 && numeric)
+                return becomeCopy(instr, a), true;
+            if (a == b && numeric)
+                return becomeCopy(instr, constantOperand(0)), true;
+            break;
+        case IR_MUL:
+            if ((rightKnown && right == 0) || (leftKnown && left == 0))
+                return becomeCopy(instr, constantOperand(0)), true;
+            if (rightKnown && right == 1)
+                return becomeCopy(instr, a), true;
+            if (leftKnown && left == 1)
+                return becomeCopy(instr, b), true;
+            break;
+        case IR_DIV:
+            if (rightKnown && right == 1)
+                return becomeCopy(instr, a), true;
+            break;
+        case IR_EQ:
+        case IR_LE:
+        case IR_GE:
+            if (a == b)
+                return becomeCopy(instr, constantOperand(1)), true;
+            break;
+        case IR_NE:
+        case IR_LT:
+        case IR_GT:
+            if (a == b)
+                return becomeCopy(instr, constantOperand(0)), true;
+            break;
+        default:
+            break;
+        }
+        return false;
+    }
+};
+
+// Copy propagation.
+//
+// Reads of a temporary that is a copy of another temporary or a constant are
+// replaced everywhere (temporaries never change once assigned). Copies of variables
+// are propagated until the variable or its source is reassigned or the next label.
+// Afterwards `x = x` moves are dropped and `t = a + b; x = t` becomes `x = a + b`
+// when `t` has no other reader.
+class CopyPropagator
+{
+public:
+    size_t run(vector<IrInstr> &code)
+    {
+        size_t before = code.size();
+        uint32_t temps = 0;
+        for (const IrInstr &instr : code)
+            if (instr.dstKind == OP_TEMP && instr.dst >= temps)
+                temps = instr.dst + 1;
+        alias.assign(temps, Operand());
+        tempCopy.assign(temps, Copy());
+        varCopy.assign(symbols.size(), Copy());
+        version.assign(symbols.size(), 0);
+        stamp = 1;
+
+        for (IrInstr &instr : code)
+            propagate(instr);
+
+        vector<uint32_t> uses(temps, 0);
+        for (const IrInstr &instr : code)
+        {
+            if (instr.aKind == OP_TEMP)
+                uses[instr.a]++;
+            if (instr.bKind == OP_TEMP)
+                uses[instr.b]++;
+        }
+
+        size_t out = 0;
+        for (size_t i = 0; i < code.size(); i++)
+        {
+            IrInstr instr = code[i];
+            if (instr.opcode == IR_COPY && instr.dest() == instr.left())
+                continue;
+            if (instr.opcode == IR_COPY && instr.dstKind == OP_VAR && instr.aKind == OP_TEMP && out > 0 &&
+                uses[instr.a] == 1)
+            {
+                IrInstr &previous = code[out - 1];
+                if (writesDest(previous.opcode) && previous.dest() == instr.left())
+                {
+                    previous.setDest(instr.dest());
+                    continue;
+                }
+            }
+            code[out++] = instr;
+        }
+        code.erase(code.begin() + out, code.end());
+        return before - out;
+    }
+
+private:
+    // `source` stands for the copy while nothing it depends on has been reassigned
+    struct Copy
+    {
+        Operand source;
+        uint32_t sourceVersion = 0;
+        uint32_t ownVersion = 0;
+        uint32_t stamp = 0;
+    };
+
+    vector<Operand> alias;  // temporaries that are copies of temporaries or constants
+    vector<Copy> tempCopy;  // temporaries that are copies of variables
+    vector<Copy> varCopy;   // variables that are copies of variables
+    vector<uint32_t> version; // bumped on every assignment to a variable
+    uint32_t stamp = 1;     // bumped at every label and function boundary
+
+    bool valid(const Copy &copy) const
+    {
+        return copy.stamp == stamp && version[copy.source.id] == copy.sourceVersion;
+    }
+
+    Operand resolve(Operand operand) const
+    {
+        if (operand.kind == OP_TEMP && operand.id < alias.size())
+        {
+            if (alias[operand.id].kind != OP_NONE)
+                return alias[operand.id];
+            if (valid(tempCopy[operand.id]))
+                return tempCopy[operand.id].source;
+        }
+        else if (operand.kind == OP_VAR && operand.id < varCopy.size())
+        {
+            const Copy &copy = varCopy[operand.id];
+            if (valid(copy) && copy.ownVersion == version[operand.id])
+                return copy.source;
+        }
+        return operand;
+    }
+
+    void propagate(IrInstr &instr)
+    {
+        if (instr.opcode == IR_LABEL || instr.opcode == IR_FUNC || instr.opcode == IR_END_FUNC)
+        {
+            stamp++; // control can arrive from elsewhere
+            return;
+        }
+        if (instr.opcode == IR_JUMP)
+            return;
+        instr.setLeft(resolve(instr.left()));
+        instr.setRight(resolve(instr.right()));
+        if (!writesDest(instr.opcode))
+            return;
+
+        Operand dest = instr.dest(), source = instr.left();
+        if (dest.kind == OP_VAR)
+            varCopy[dest.id] = Copy{Operand(), 0, ++version[dest.id], 0};
+        if (instr.opcode != IR_COPY || dest == source)
+            return;
+        if (dest.kind == OP_TEMP)
+        {
+            if (source.kind == OP_TEMP || source.kind == OP_CONST || source.kind == OP_STRING)
+                alias[dest.id] = source;
+            else if (source.kind == OP_VAR)
+                tempCopy[dest.id] = Copy{source, version[source.id], 0, stamp};
+        }
+        else if (dest.kind == OP_VAR && source.kind == OP_VAR)
+            varCopy[dest.id] = Copy{source, version[source.id], version[dest.id], stamp};
+    }
+};
+
+// A set of variable symbols, kept either as its members or, when it holds nearly
+// every symbol, as the symbols it is missing. The list is sorted.
+struct SymbolSet
+{
+    bool complement = true; // the default is the set of all symbols
+    vector<uint32_t> ids;
+
+    bool contains(uint32_t id) const
+    {
+        return binary_search(ids.begin(), ids.end(), id) != complement;
+    }
+
+    bool operator==(const SymbolSet &other) const
+    {
+        return complement == other.complement && ids == other.ids;
+    }
+    bool operator!=(const SymbolSet &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+inline vector<uint32_t> sortedUnion(const vector<uint32_t> &a, const vector<uint32_t> &b)
+{
+    vector<uint32_t> out;
+    set_union(a.begin(), a.end(), b.begin(), b.end(), back_inserter(out));
+    return out;
+}
+
+inline vector<uint32_t> sortedDifference(const vector<uint32_t> &a, const vector<uint32_t> &b)
+{
+    vector<uint32_t> out;
+    set_difference(a.begin(), a.end(), b.begin(), b.end(), back_inserter(out));
+    return out;
+}
+
+inline SymbolSet intersect(const SymbolSet &a, const SymbolSet &b)
+{
+    SymbolSet out;
+    out.complement = a.complement && b.complement;
+    if (a.complement && b.complement)
+        out.ids = sortedUnion(a.ids, b.ids);
+    else if (a.complement)
+        out.ids = sortedDifference(b.ids, a.ids);
+    else if (b.complement)
+        out.ids = sortedDifference(a.ids, b.ids);
+    else
+        set_intersection(a.ids.begin(), a.ids.end(), b.ids.begin(), b.ids.end(), back_inserter(out.ids));
+    return out;
+}
+
+// Dead code elimination.
+//
+// Removes blocks that cannot be reached, jumps to the label that follows them,
+// labels nobody jumps to, temporaries that are never read and stores to variables
+// that are overwritten on every path before they are read. Every variable is live
+// when the program ends (its final values are the result), so a variable's last
+// store always stays. Variable liveness is a backward dataflow over basic blocks
+// that tracks the variables whose current value is never needed; a read only
+// counts when the instruction doing it is needed, so chains of dead stores across
+// blocks go in one analysis.
+class DeadCodeEliminator
+{
+public:
+    size_t run(vector<IrInstr> &code)
+    {
+        size_t before = code.size();
+        bool changed = true;
+        while (changed)
+        {
+            changed = removeUnreachable(code);
+            changed |= removeRedundantJumps(code);
+            changed |= removeDeadStores(code);
+        }
+        removeUnusedLabels(code);
+        return before - code.size();
+    }
+
+private:
+    // Keeps only the marked instructions; true if any were dropped
+    static bool compact(vector<IrInstr> &code, const vector<bool> &keep)
+    {
+        size_t out = 0;
+        for (size_t i = 0; i < code.size(); i++)
+            if (keep[i])
+                code[out++] = code[i];
+        bool changed = out != code.size();
+        code.erase(code.begin() + out, code.end());
+        return changed;
+    }
+
+    static bool removeUnreachable(vector<IrInstr> &code)
+    {
+        ControlFlowGraph cfg(code);
+        vector<bool> keep(code.size(), true);
+        for (BlockId b = 0; b < cfg.blockCount(); b++)
+            if (!cfg.reachable(b))
+                for (uint32_t i = cfg.block(b).begin; i < cfg.block(b).end; i++)
+                    keep[i] = code[i].opcode == IR_FUNC || code[i].opcode == IR_END_FUNC;
+        return compact(code, keep);
+    }
+
+    // `goto L` and `if ... goto L` directly before `L:`
+    // Walks backwards so a whole run of branches to the labels after it goes at once
+    static bool removeRedundantJumps(vector<IrInstr> &code)
+    {
+        vector<bool> keep(code.size(), true);
+        vector<uint32_t> runOf;  // per label: the run of labels it was last seen in
+        uint32_t run = 1;        // labels reached from here by falling through
+        for (size_t i = code.size(); i-- > 0;)
+        {
+            const IrInstr &instr = code[i];
+            if (instr.opcode == IR_LABEL)
+            {
+                if (instr.a >= runOf.size())
+                    runOf.resize(instr.a + 1, 0);
+                runOf[instr.a] = run;
+                continue;
+            }
+            if (isJump(instr.opcode) && jumpTarget(instr) < runOf.size() && runOf[jumpTarget(instr)] == run)
+                keep[i] = false;
+            else
+                run++;
+        }
+        return compact(code, keep);
+    }
+
+    static void removeUnusedLabels(vector<IrInstr> &code)
+    {
+        vector<bool> used;
+        for (const IrInstr &instr : code)
+        {
+            if (!isJump(instr.opcode))
+                continue;
+            if (jumpTarget(instr) >= used.size())
+                used.resize(jumpTarget(instr) + 1, false);
+            used[jumpTarget(instr)] = true;
+        }
+        vector<bool> keep(code.size(), true);
+        for (size_t i = 0; i < code.size(); i++)
+            if (code[i].opcode == IR_LABEL)
+                keep[i] = code[i].a < used.size() && used[code[i].a];
+        compact(code, keep);
+    }
+
+    // Scratch state of the backward walk over one block
+    struct StoreWalk
+    {
+        vector<uint8_t> state;      // per variable: 1 dead, 2 live, 0 as at the block's end
+        vector<uint32_t> touched;   // variables whose state is set
+        vector<bool> tempLive;      // read by a live instruction further down the block
+        vector<uint32_t> liveTemps; // temporaries set in tempLive
+        vector<bool> readElsewhere; // per temporary: read outside the block defining it
+    };
+
+    static bool removeDeadStores(vector<IrInstr> &code)
+    {
+        ControlFlowGraph cfg(code);
+        BlockId blocks = (BlockId)cfg.blockCount();
+
+        StoreWalk walk;
+        walk.state.assign(symbols.size(), 0);
+        uint32_t temps = 0;
+        for (const IrInstr &instr : code)
+            if (instr.dstKind == OP_TEMP && instr.dst >= temps)
+                temps = instr.dst + 1;
+        vector<BlockId> definedIn(temps, NoBlock);
+        for (BlockId b = 0; b < blocks; b++)
+            for (uint32_t i = cfg.block(b).begin; i < cfg.block(b).end; i++)
+                if (writesDest(code[i].opcode) && code[i].dstKind == OP_TEMP)
+                    definedIn[code[i].dst] = b;
+        walk.tempLive.assign(temps, false);
+        walk.readElsewhere.assign(temps, false);
+        for (BlockId b = 0; b < blocks; b++)
+            for (uint32_t i = cfg.block(b).begin; i < cfg.block(b).end; i++)
+                for (Operand read : {code[i].left(), code[i].right()})
+                    if (read.kind == OP_TEMP && read.id < temps && definedIn[read.id] != b)
+                        walk.readElsewhere[read.id] = true;
+
+        // deadIn[b]: variables whose value at the start of b is never needed: on
+        // every path they are overwritten first or only read by stores that are
+        // themselves dead. Starts at "everything" and shrinks to the greatest
+        // fixpoint; postorder visits successors first.
+        vector<SymbolSet> deadIn(blocks);
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (BlockId b : cfg.postorder())
+            {
+                SymbolSet in = walkBlock(cfg, code, b, deadOut(cfg, b, deadIn), walk, nullptr);
+                if (in != deadIn[b])
+                {
+                    deadIn[b] = move(in);
+                    changed = true;
+                }
+            }
+        }
+
+        vector<bool> keep(code.size(), true);
+        for (BlockId b = 0; b < blocks; b++)
+            walkBlock(cfg, code, b, deadOut(cfg, b, deadIn), walk, &keep);
+        return compact(code, keep);
+    }
+
+    // Walks block b backwards from the variables dead at its end, clearing keep
+    // for dead stores when given; returns the variables dead at its start
+    static SymbolSet walkBlock(const ControlFlowGraph &cfg, const vector<IrInstr> &code, BlockId b,
+                               SymbolSet out, StoreWalk &walk, vector<bool> *keep)
+    {
+        for (uint32_t i = cfg.block(b).end; i-- > cfg.block(b).begin;)
+        {
+            const IrInstr &instr = code[i];
+            if (writesDest(instr.opcode))
+            {
+                Operand dest = instr.dest();
+                bool dead;
+                if (dest.kind == OP_TEMP)
+                    dead = !walk.tempLive[dest.id] && !walk.readElsewhere[dest.id];
+                else
+                {
+                    uint8_t state = walk.state[dest.id];
+                    dead = state == 1 || (state == 0 && out.contains(dest.id));
+                    if (state == 0)
+                        walk.touched.push_back(dest.id);
+                    walk.state[dest.id] = 1; // overwritten here either way
+                }
+                if (dead)
+                {
+                    if (keep)
+                        (*keep)[i] = false;
+                    continue;
+                }
+            }
+            for (Operand read : {instr.left(), instr.right()})
+                if (read.kind == OP_VAR)
+                {
+                    if (walk.state[read.id] == 0)
+                        walk.touched.push_back(read.id);
+                    walk.state[read.id] = 2;
+                }
+                else if (read.kind == OP_TEMP && read.id < walk.tempLive.size() && !walk.tempLive[read.id])
+                {
+                    walk.tempLive[read.id] = true;
+                    walk.liveTemps.push_back(read.id);
+                }
+        }
+
+        // Variables first seen written are dead at the start, first seen read live
+        vector<uint32_t> dead, live;
+        for (uint32_t id : walk.touched)
+        {
+            (walk.state[id] == 1 ? dead : live).push_back(id);
+            walk.state[id] = 0;
+        }
+        walk.touched.clear();
+        for (uint32_t id : walk.liveTemps)
+            walk.tempLive[id] = false;
+        walk.liveTemps.clear();
+        sort(dead.begin(), dead.end());
+        sort(live.begin(), live.end());
+        if (out.complement)
+            out.ids = sortedUnion(sortedDifference(out.ids, dead), live);
+        else
+            out.ids = sortedDifference(sortedUnion(out.ids, dead), live);
+        return out;
+    }
+
+    static SymbolSet deadOut(const ControlFlowGraph &cfg, BlockId b, const vector<SymbolSet> &deadIn)
+    {
+        if (cfg.exits(b))
+            return SymbolSet{false, {}}; // everything is live at the end
+        SymbolSet out;
+        for (BlockId s : cfg.successors(b))
+            out = intersect(out, deadIn[s]);
+        return out;
+    }
+};
+
+// Sparse conditional constant propagation (Wegman and Zadeck) on SSA form.
+//
+// Every name starts unknown and only moves down the lattice unknown -> constant ->
+// varying, and a block is evaluated only once an edge into it is executable, so
+// each instruction is revisited a bounded number of times along its def-use
+// chains. Unlike ConstantFolder it sees through labels and loops: a variable that
+// is the same constant on every executable path into a join is known there.
+// Uses of constants are replaced and branches with a known outcome become jumps
+// or disappear.
+class SparseConstantPropagator
+{
+public:
+    size_t run(vector<IrInstr> &code)
+    {
+        if (code.empty())
+            return 0;
+        SsaForm ssa(code);
+        analyze(ssa, code);
+        size_t removed = rewrite(ssa, code);
+        ssa.destruct();
+        return removed;
+    }
+
+private:
+    enum Level : uint8_t
+    {
+        UNKNOWN,
+        CONSTANT,
+        VARYING
+    };
+
+    struct Value
+    {
+        Level level;
+        Operand constant;
+    };
+
+    vector<Value> values;       // per SSA name
+    vector<bool> blockLive;     // some executable edge reaches the block
+    vector<bool> edgeLive;      // two slots per block, as in cfg.successors()
+    vector<BlockId> flowWork;   // blocks with a newly executable incoming edge
+    vector<uint32_t> ssaWork;   // instructions whose operands changed
+
+    Value valueOf(Operand operand) const
+    {
+        if (operand.kind == OP_CONST)
+            return {CONSTANT, operand};
+        if (operand.kind == OP_TEMP && operand.id < values.size())
+            return values[operand.id];
+        return {VARYING, Operand()};
+    }
+
+    static Value meet(Value a, Value b)
+    {
+        if (a.level == UNKNOWN)
+            return b;
+        if (b.level == UNKNOWN)
+            return a;
+        if (a.level == CONSTANT && b.level == CONSTANT && a.constant == b.constant)
+            return a;
+        return {VARYING, Operand()};
+    }
+
+    bool edgeIsLive(const ControlFlowGraph &cfg, BlockId from, BlockId to) const
+    {
+        BlockList next = cfg.successors(from);
+        for (uint32_t k = 0; k < next.size(); k++)
+            if (next.first[k] == to)
+                return edgeLive[from * 2 + k];
+        return false;
+    }
+
+    void markEdge(const ControlFlowGraph &cfg, BlockId from, BlockId to)
+    {
+        if (to == NoBlock)
+            return;
+        BlockList next = cfg.successors(from);
+        for (uint32_t k = 0; k < next.size(); k++)
+            if (next.first[k] == to && !edgeLive[from * 2 + k])
+            {
+                edgeLive[from * 2 + k] = true;
+                flowWork.push_back(to);
+            }
+    }
+
+    // Outcome of a conditional branch: 0 not taken, 1 taken, 2 either, 3 not known yet
+    int branchOutcome(const IrInstr &instr) const
+    {
+        Value left = valueOf(instr.left());
+        Value right = instr.opcode == IR_BRANCH ? Value{CONSTANT, Operand()} : valueOf(instr.right());
+        if (left.level == VARYING || right.level == VARYING)
+            return 2;
+        if (left.level == UNKNOWN || right.level == UNKNOWN)
+            return 3;
+        int64_t l, r, result;
+        if (instr.opcode == IR_BRANCH)
+            return constantValue(left.constant, l, true) ? l != 0 : 2;
+        if (constantValue(left.constant, l) && constantValue(right.constant, r) && evaluate(instr.opcode, l, r, result))
+            return result != 0;
+        return 2;
+    }
+
+    void evaluateInstruction(SsaForm &ssa, const vector<IrInstr> &code, uint32_t i)
+    {
+        const ControlFlowGraph &cfg = ssa.cfg();
+        BlockId b = ssa.blockOf(i);
+        if (!blockLive[b])
+            return;
+        const IrInstr &instr = code[i];
+        Value result{UNKNOWN, Operand()};
+        switch (instr.opcode)
+        {
+        case IR_PHI:
+        {
+            BlockList preds = cfg.predecessors(b);
+            Operand *args = ssa.phiOperands(instr);
+            for (uint32_t j = 0; j < preds.size(); j++)
+                if (edgeIsLive(cfg, preds.first[j], b))
+                    result = meet(result, valueOf(args[j]));
+            break;
+        }
+        case IR_COPY:
+            result = valueOf(instr.left());
+            break;
+        case IR_JUMP:
+            markEdge(cfg, b, cfg.blockOfLabel(instr.a));
+            return;
+        default:
+            if (instr.opcode == IR_BRANCH || isCompareBranch(instr.opcode))
+            {
+                int outcome = branchOutcome(instr);
+                if (outcome == 1 || outcome == 2)
+                    markEdge(cfg, b, cfg.blockOfLabel(instr.dst));
+                if ((outcome == 0 || outcome == 2) && b + 1 < cfg.blockCount())
+                    markEdge(cfg, b, b + 1);
+                return;
+            }
+            if (!isBinaryOpcode(instr.opcode))
+                return;
+            Value left = valueOf(instr.left()), right = valueOf(instr.right());
+            int64_t l, r, folded;
+            if (left.level == VARYING || right.level == VARYING)
+                result = {VARYING, Operand()};
+            else if (left.level == CONSTANT && right.level == CONSTANT)
+            {
+                if (constantValue(left.constant, l) && constantValue(right.constant, r) &&
+                    evaluate(instr.opcode, l, r, folded))
+                    result = {CONSTANT, constantOperand(folded)};
+                else
+                    result = {VARYING, Operand()};
+            }
+            break;
+        }
+
+        if (instr.dstKind != OP_TEMP || result.level == UNKNOWN)
+            return;
+        Value &current = values[instr.dst];
+        if (current.level == VARYING || (current.level == result.level && current.constant == result.constant))
+            return;
+        current = current.level == CONSTANT ? Value{VARYING, Operand()} : result;
+        for (uint32_t use : ssa.uses(instr.dst))
+            ssaWork.push_back(use);
+    }
+
+    void analyze(SsaForm &ssa, const vector<IrInstr> &code)
+    {
+        const ControlFlowGraph &cfg = ssa.cfg();
+        values.assign(ssa.nameCount(), Value{UNKNOWN, Operand()});
+        for (uint32_t n = 0; n < ssa.nameCount(); n++)
+            if (ssa.definition(n) == SsaForm::NoIndex)
+                values[n] = {VARYING, Operand()};
+        blockLive.assign(cfg.blockCount(), false);
+        edgeLive.assign(cfg.blockCount() * 2, false);
+        flowWork = {0};
+
+        while (!flowWork.empty() || !ssaWork.empty())
+        {
+            while (!flowWork.empty())
+            {
+                BlockId b = flowWork.back();
+                flowWork.pop_back();
+                const BasicBlock &block = cfg.block(b);
+                if (blockLive[b])
+                {
+                    // Only the phis see the new edge
+                    for (uint32_t i = block.begin; i < block.end; i++)
+                        if (code[i].opcode == IR_PHI)
+                            evaluateInstruction(ssa, code, i);
+                        else if (code[i].opcode != IR_LABEL)
+                            break;
+                    continue;
+                }
+                blockLive[b] = true;
+                for (uint32_t i = block.begin; i < block.end; i++)
+                    evaluateInstruction(ssa, code, i);
+                if (!isBlockEnd(code[block.end - 1].opcode))
+                    for (BlockId s : cfg.successors(b))
+                        markEdge(cfg, b, s);
+            }
+            while (!ssaWork.empty())
+            {
+                uint32_t i = ssaWork.back();
+                ssaWork.pop_back();
+                evaluateInstruction(ssa, code, i);
+            }
+        }
+    }
+
+    size_t rewrite(SsaForm &ssa, vector<IrInstr> &code)
+    {
+        const ControlFlowGraph &cfg = ssa.cfg();
+        auto substitute = [&](Operand operand)
+        {
+            Value value = valueOf(operand);
+            return operand.kind == OP_TEMP && value.level == CONSTANT ? value.constant : operand;
+        };
+        size_t removed = 0;
+        for (BlockId b = 0; b < cfg.blockCount(); b++)
+        {
+            if (!blockLive[b])
+                continue;
+            for (uint32_t i = cfg.block(b).begin; i < cfg.block(b).end; i++)
+            {
+                IrInstr &instr = code[i];
+                if (instr.opcode == IR_PHI)
+                {
+                    // Operands on dead edges must not turn into copies
+                    BlockList preds = cfg.predecessors(b);
+                    Operand *args = ssa.phiOperands(instr);
+                    for (uint32_t j = 0; j < preds.size(); j++)
+                        if (!edgeIsLive(cfg, preds.first[j], b))
+                            args[j] = instr.dest();
+                    continue;
+                }
+                if (instr.opcode == IR_BRANCH || isCompareBranch(instr.opcode))
+                {
+                    int outcome = branchOutcome(instr);
+                    if (outcome == 0)
+                    {
+                        ssa.remove(i);
+                        removed++;
+                        continue;
+                    }
+                    if (outcome == 1)
+                    {
+                        instr = IrInstr(IR_JUMP, Operand(), instr.dest());
+                        continue;
+                    }
+                }
+                instr.setLeft(substitute(instr.left()));
+                instr.setRight(substitute(instr.right()));
+                Value value = valueOf(instr.dest());
+                if (isBinaryOpcode(instr.opcode) && instr.dstKind == OP_TEMP && value.level == CONSTANT)
+                    instr = IrInstr(IR_COPY, instr.dest(), value.constant);
+            }
+        }
+        return removed;
+    }
+};
+
+// Value numbering on SSA form, scoped by the dominator tree.
+//
+// Blocks are visited in dominator-tree preorder and every copy or binary operation
+// is looked up in a hash table keyed by its opcode and the value numbers of its
+// operands. An entry is only reused when its block dominates the current one, so
+// a hit in the same block is the local case and a hit in a dominating block the
+// global one. Because variables are renamed, two reads of the same version, such
+// as r.length with no store in between, get the same number. Only ordinary
+// temporaries are recorded as available values: the uses of a redundant temporary
+// are renamed to the earlier one and a redundant assignment to a variable becomes
+// a copy of it.
+class ValueNumbering
+{
+public:
+    size_t run(vector<IrInstr> &code)
+    {
+        if (code.empty())
+            return 0;
+        SsaForm ssa(code);
+        DominatorTree dominators(ssa.cfg());
+        leader.resize(ssa.nameCount());
+        for (uint32_t n = 0; n < ssa.nameCount(); n++)
+            leader[n] = Operand(OP_TEMP, n);
+        size_t capacity = 16;
+        while (capacity < code.size() * 2)
+            capacity *= 2;
+        table.assign(capacity, Entry{IR_COPY, Operand(), Operand(), SsaForm::NoIndex});
+
+        size_t removed = 0;
+        vector<BlockId> stack = {0};
+        while (!stack.empty())
+        {
+            BlockId b = stack.back();
+            stack.pop_back();
+            for (BlockId child : dominators.children(b))
+                stack.push_back(child);
+            for (uint32_t i = ssa.cfg().block(b).begin; i < ssa.cfg().block(b).end; i++)
+                removed += number(ssa, dominators, code, i);
+        }
+
+        // Rename uses of redundant temporaries, in phis and unreachable code too
+        for (uint32_t i = 0; i < code.size(); i++)
+        {
+            IrInstr &instr = code[i];
+            if (instr.opcode == IR_PHI)
+            {
+                Operand *args = ssa.phiOperands(instr);
+                for (uint32_t j = 0; j < ssa.cfg().predecessors(ssa.blockOf(i)).size(); j++)
+                    args[j] = valueOf(args[j]);
+                continue;
+            }
+            instr.setLeft(valueOf(instr.left()));
+            instr.setRight(valueOf(instr.right()));
+        }
+        ssa.destruct();
+        return removed;
+    }
+
+private:
+    struct Entry
+    {
+        IrOpcode opcode;
+        Operand left, right;
+        uint32_t instruction; // NoIndex for an empty slot
+    };
+
+    vector<Operand> leader; // per SSA name: itself, or the value it was found equal to
+    vector<Entry> table;    // open addressing, linear probing
+
+    Operand valueOf(Operand operand) const
+    {
+        return operand.kind == OP_TEMP && operand.id < leader.size() ? leader[operand.id] : operand;
+    }
+
+    static bool before(Operand a, Operand b)
+    {
+        return a.kind != b.kind ? a.kind < b.kind : a.id < b.id;
+    }
+
+    // Puts the operands of commutative operations in a fixed order. Addition is
+    // left alone: it concatenates when an operand is a string.
+    static void canonicalize(IrOpcode &opcode, Operand &left, Operand &right)
+    {
+        if (!before(right, left))
+            return;
+        switch (opcode)
+        {
+        case IR_MUL:
+        case IR_EQ:
+        case IR_NE:
+            break;
+        case IR_LT:
+        case IR_GT:
+            opcode = opcode == IR_LT ? IR_GT : IR_LT;
+            break;
+        case IR_LE:
+        case IR_GE:
+            opcode = opcode == IR_LE ? IR_GE : IR_LE;
+            break;
+        default:
+            return;
+        }
+        swap(left, right);
+    }
+
+    static size_t hash(IrOpcode opcode, Operand left, Operand right)
+    {
+        uint64_t h = opcode;
+        h = h * 0x9E3779B97F4A7C15ull + ((uint64_t)left.kind << 32 | left.id);
+        h = h * 0x9E3779B97F4A7C15ull + ((uint64_t)right.kind << 32 | right.id);
+        return (size_t)(h ^ h >> 29);
+    }
+
+    // Numbers one instruction; returns 1 when it was removed
+    size_t number(SsaForm &ssa, const DominatorTree &dominators, vector<IrInstr> &code, uint32_t i)
+    {
+        IrInstr &instr = code[i];
+        if (!writesDest(instr.opcode) || instr.dstKind != OP_TEMP)
+            return 0;
+        IrOpcode opcode = instr.opcode;
+        Operand left = valueOf(instr.left()), right = valueOf(instr.right());
+        bool ordinary = ssa.variableOf(instr.dst) == NoSymbol;
+
+        // A temporary copied from anything but a variable is that value; only
+        // copies of variables are numbered
+        bool readsVariable = left.kind == OP_TEMP && ssa.variableOf(left.id) != NoSymbol;
+        if (opcode == IR_COPY && !readsVariable)
+        {
+            if (!ordinary)
+                return 0;
+            leader[instr.dst] = left;
+            ssa.remove(i);
+            return 1;
+        }
+        canonicalize(opcode, left, right);
+
+        size_t mask = table.size() - 1;
+        for (size_t slot = hash(opcode, left, right) & mask;; slot = (slot + 1) & mask)
+        {
+            Entry &entry = table[slot];
+            bool same = entry.instruction != SsaForm::NoIndex && entry.opcode == opcode &&
+                        entry.left == left && entry.right == right;
+            if (same && dominators.dominates(ssa.blockOf(entry.instruction), ssa.blockOf(i)))
+            {
+                Operand available = code[entry.instruction].dest();
+                if (!ordinary)
+                {
+                    instr = IrInstr(IR_COPY, instr.dest(), available);
+                    return 0;
+                }
+                leader[instr.dst] = available;
+                ssa.remove(i);
+                return 1;
+            }
+            // An entry from a block that does not dominate this one is out of
+            // scope for good: preorder has left that block's subtree
+            if (entry.instruction == SsaForm::NoIndex || same)
+            {
+                if (ordinary)
+                    entry = Entry{opcode, left, right, i};
+                return 0;
+            }
+        }
+    }
+};
+
+// Loop-invariant code motion.
+//
+// A copy or binary operation into a temporary is invariant in a loop when each
+// operand is a constant, a variable the loop never assigns, or a temporary defined
+// outside the loop or itself hoisted out of it. Such an instruction moves to a
+// preheader in front of the outermost loop it is invariant in. The operations
+// have no side effects, so moving them out of conditionally executed blocks is
+// safe, except division: it is only hoisted when the divisor is a constant that
+// cannot trap or when its block dominates every exit of the loop, including every
+// return inside it, so it would have run anyway. The preheader is placed right before the header label; jumps
+// from outside the loop are sent to it and a fallthrough from inside skips it.
+class LoopInvariantCodeMotion
+{
+public:
+    // Moves instructions without removing any
+    size_t run(vector<IrInstr> &code)
+    {
+        if (code.empty())
+            return 0;
+        ControlFlowGraph cfg(code);
+        DominatorTree dominators(cfg);
+        LoopInfo loops(cfg, dominators);
+        if (loops.loopCount() == 0)
+            return 0;
+        findDefinitions(cfg, loops, code);
+
+        vector<uint32_t> target(code.size(), LoopInfo::NoLoop);
+        vector<vector<uint32_t>> hoisted(loops.loopCount());
+        for (BlockId b : cfg.reversePostorder())
+        {
+            if (loops.loopOf(b) == LoopInfo::NoLoop)
+                continue;
+            for (uint32_t i = cfg.block(b).begin; i < cfg.block(b).end; i++)
+            {
+                const IrInstr &instr = code[i];
+                if (!writesDest(instr.opcode) || instr.dstKind != OP_TEMP || definitions[instr.dst] != 1)
+                    continue;
+                for (uint32_t l = loops.loopOf(b); l != LoopInfo::NoLoop; l = loops.loop(l).parent)
+                {
+                    if (!invariant(loops, instr.left(), l) || !invariant(loops, instr.right(), l) ||
+                        (instr.opcode == IR_DIV && !divisionIsSafe(cfg, dominators, loops, code, instr, b, l)))
+                        break;
+                    target[i] = l;
+                }
+                if (target[i] != LoopInfo::NoLoop)
+                {
+                    hoistedFrom[instr.dst] = target[i];
+                    hoisted[target[i]].push_back(i);
+                }
+            }
+        }
+
+        // Preheaders need a label when a jump from outside the loop enters it
+        uint32_t nextLabel = 0;
+        for (const IrInstr &instr : code)
+            for (Operand operand : {instr.dest(), instr.left(), instr.right()})
+                if ((operand.kind == OP_TEMP || operand.kind == OP_LABEL) && operand.id >= nextLabel)
+                    nextLabel = operand.id + 1;
+        vector<uint32_t> headerLoop(cfg.blockCount(), LoopInfo::NoLoop);
+        vector<uint32_t> preheader(cfg.blockCount(), SsaForm::NoIndex);
+        for (uint32_t l = 0; l < loops.loopCount(); l++)
+        {
+            BlockId header = loops.loop(l).header;
+            if (hoisted[l].empty() || code[cfg.block(header).begin].opcode != IR_LABEL)
+                continue;
+            headerLoop[header] = l;
+            for (BlockId p : cfg.predecessors(header))
+            {
+                const IrInstr &last = code[cfg.block(p).end - 1];
+                if (!loops.contains(l, p) && isJump(last.opcode) &&
+                    jumpTarget(last) == code[cfg.block(header).begin].a)
+                    preheader[header] = nextLabel;
+            }
+            if (preheader[header] == nextLabel)
+                nextLabel++;
+        }
+
+        vector<IrInstr> result;
+        result.reserve(code.size() + 2 * loops.loopCount());
+        for (BlockId b = 0; b < cfg.blockCount(); b++)
+        {
+            uint32_t l = headerLoop[b];
+            if (l != LoopInfo::NoLoop)
+            {
+                Operand headerLabel = code[cfg.block(b).begin].left();
+                if (b > 0 && fallsThrough(code[cfg.block(b - 1).end - 1].opcode) && loops.contains(l, b - 1))
+                    result.push_back(IrInstr(IR_JUMP, Operand(), headerLabel));
+                if (preheader[b] != SsaForm::NoIndex)
+                    result.push_back(IrInstr(IR_LABEL, Operand(), Operand(OP_LABEL, preheader[b])));
+                for (uint32_t i : hoisted[l])
+                    result.push_back(code[i]);
+            }
+            for (uint32_t i = cfg.block(b).begin; i < cfg.block(b).end; i++)
+            {
+                if (target[i] != LoopInfo::NoLoop)
+                    continue;
+                IrInstr instr = code[i];
+                if (isJump(instr.opcode))
+                {
+                    BlockId to = cfg.blockOfLabel(jumpTarget(instr));
+                    if (to != NoBlock && preheader[to] != SsaForm::NoIndex && !loops.contains(headerLoop[to], b))
+                    {
+                        if (instr.opcode == IR_JUMP)
+                            instr.a = preheader[to];
+                        else
+                            instr.dst = preheader[to];
+                    }
+                }
+                result.push_back(instr);
+            }
+        }
+        code = move(result);
+        return 0;
+    }
+
+private:
+    vector<uint32_t> definitions;           // per temporary: how many instructions assign it
+    vector<BlockId> definedIn;              // per temporary
+    vector<uint32_t> hoistedFrom;           // per temporary: outermost loop it left, or NoLoop
+    vector<vector<SymbolId>> assigned;      // per loop: sorted variables assigned inside it
+    vector<vector<BlockId>> exitingBlocks;  // per loop, filled on first use
+    vector<bool> exitsKnown;
+
+    void findDefinitions(const ControlFlowGraph &cfg, const LoopInfo &loops, const vector<IrInstr> &code)
+    {
+        uint32_t temps = 0;
+        for (const IrInstr &instr : code)
+            if (writesDest(instr.opcode) && instr.dstKind == OP_TEMP && instr.dst >= temps)
+                temps = instr.dst + 1;
+        definitions.assign(temps, 0);
+        definedIn.assign(temps, NoBlock);
+        hoistedFrom.assign(temps, LoopInfo::NoLoop);
+        assigned.assign(loops.loopCount(), {});
+        exitingBlocks.assign(loops.loopCount(), {});
+        exitsKnown.assign(loops.loopCount(), false);
+
+        for (BlockId b = 0; b < cfg.blockCount(); b++)
+            for (uint32_t i = cfg.block(b).begin; i < cfg.block(b).end; i++)
+            {
+                const IrInstr &instr = code[i];
+                if (!writesDest(instr.opcode))
+                    continue;
+                if (instr.dstKind == OP_TEMP)
+                {
+                    definitions[instr.dst]++;
+                    definedIn[instr.dst] = b;
+                }
+                else if (instr.dstKind == OP_VAR)
+                    for (uint32_t l = loops.loopOf(b); l != LoopInfo::NoLoop; l = loops.loop(l).parent)
+                        assigned[l].push_back(instr.dst);
+            }
+        for (vector<SymbolId> &vars : assigned)
+        {
+            sort(vars.begin(), vars.end());
+            vars.erase(unique(vars.begin(), vars.end()), vars.end());
+        }
+    }
+
+    bool invariant(const LoopInfo &loops, Operand operand, uint32_t l) const
+    {
+        switch (operand.kind)
+        {
+        case OP_VAR:
+            return !binary_search(assigned[l].begin(), assigned[l].end(), operand.id);
+        case OP_TEMP:
+        {
+            if (operand.id >= definitions.size() || definitions[operand.id] == 0)
+                return true;
+            if (!loops.contains(l, definedIn[operand.id]))
+                return true;
+            // Hoisted out of this loop or one around it
+            uint32_t from = hoistedFrom[operand.id];
+            return from != LoopInfo::NoLoop && loops.contains(from, loops.loop(l).header);
+        }
+        default:
+            return true;
+        }
+    }
+
+    bool divisionIsSafe(const ControlFlowGraph &cfg, const DominatorTree &dominators, const LoopInfo &loops,
+                        const vector<IrInstr> &code, const IrInstr &instr, BlockId b, uint32_t l)
+    {
+        int64_t divisor;
+        if (constantValue(instr.right(), divisor) && divisor != 0 && divisor != -1)
+            return true;
+        if (!exitsKnown[l])
+        {
+            for (BlockId m : loops.blocks(l))
+            {
+                bool exiting = cfg.exits(m);
+                for (BlockId s : cfg.successors(m))
+                    exiting |= !loops.contains(l, s);
+                // A return leaves the loop without an edge out of it
+                for (uint32_t i = cfg.block(m).begin; i < cfg.block(m).end && !exiting; i++)
+                    exiting = code[i].opcode == IR_RETURN;
+                if (exiting)
+                    exitingBlocks[l].push_back(m);
+            }
+            exitsKnown[l] = true;
+        }
+        if (exitingBlocks[l].empty())
+            return false; // never left, so the loop need not reach the division
+        for (BlockId m : exitingBlocks[l])
+            if (!dominators.dominates(b, m))
+                return false;
+        return true;
+    }
+};
+
+// An optimization pass: rewrites the IR in place and returns how many instructions
+// it removed. The passes run in this order.
+struct IrPass
+{
+    const char *name;
+    size_t (*run)(vector<IrInstr> &code);
+};
+
+inline const vector<IrPass> &irPasses()
+{
+    static const vector<IrPass> passes = {
+        {"constant folding", [](vector<IrInstr> &code)
+         { return ConstantFolder().run(code); }},
+        {"value numbering", [](vector<IrInstr> &code)
+         { return ValueNumbering().run(code); }},
+        {"loop invariant code motion", [](vector<IrInstr> &code)
+         { return LoopInvariantCodeMotion().run(code); }},
+        {"copy propagation", [](vector<IrInstr> &code)
+         { return CopyPropagator().run(code); }},
+        {"constant propagation", [](vector<IrInstr> &code)
+         { return SparseConstantPropagator().run(code); }},
+        {"dead code", [](vector<IrInstr> &code)
+         { return DeadCodeEliminator().run(code); }},
+    };
+    return passes;
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include "Lexer.h"
+
+// Parallel tokenization for large sources.
+//
+// The buffer is cut into chunks that start right after a newline. The only lexer
+// state that can carry across a newline is "inside a string literal" (the language
+// has no comments), so a pre-pass computes, for every chunk in parallel, where that
+// state ends up when the chunk is entered outside a string and when it is entered
+// inside one. A short sequential walk over those summaries fixes the real state at
+// each chunk boundary. Each chunk is then lexed on its own thread with its own
+// starting line, and the per-chunk token lists are stitched together in order.
+
+namespace parallel_lex
+{
+    // Where string state ends up after walking a range from a given entry state
+    struct StringWalk
+    {
+        bool inside = false;
+        int escapedNewlines = 0;    // newlines escaped inside strings; the lexer does not count them
+        size_t firstClose = 0;      // offset after the first closing quote (end if none)
+        int escapedBeforeClose = 0; // escapedNewlines up to firstClose
+    };
+
+    // Summary of one chunk for both possible entry states
+    struct ChunkScan
+    {
+        size_t begin = 0, end = 0;
+        int newlines = 0;
+        StringWalk fromOutside, fromInside;
+    };
+
+    struct ChunkResult
+    {
+        vector<Token> tokens;
+        StringInterner names;
+        string errorMessage;
+        int errorLine = 0;
+    };
+
+    // Runs fn(i) for i in [0, count) on `threads` workers pulling from a shared counter
+    template <typename Fn>
+    void parallelFor(size_t count, unsigned threads, Fn fn)
+    {
+        atomic<size_t> next(0);
+        auto worker = [&]
+        {
+            for (size_t i = next++; i < count; i = next++)
+                fn(i);
+        };
+        vector<thread> pool;
+        for (unsigned t = 1; t < threads && t < count; t++)
+            pool.emplace_back(worker);
+        worker();
+        for (thread &t : pool)
+            t.join();
+    }
+
+    // Follows string state from `pos` to `end`, starting inside a string or not
+    inline StringWalk followStrings(const char *text, size_t pos, size_t end, bool inside)
+    {
+        const lexscan::Kernels &scan = lexscan::kernels;
+        StringWalk walk;
+        walk.firstClose = end;
+        bool closed = false;
+        while (pos < end)
+        {
+            if (!inside)
+            {
+                const void *quote = memchr(text + pos, '"', end - pos);
+                if (!quote)
+                    break;
+                pos = (const char *)quote - text + 1;
+                inside = true;
+                continue;
+            }
+            pos = scan.findStringStop(text, pos, end);
+            if (pos >= end)
+                break;
+            if (text[pos] == '"')
+            {
+                inside = false;
+                pos++;
+                if (!closed)
+                {
+                    walk.firstClose = pos;
+                    walk.escapedBeforeClose = walk.escapedNewlines;
+                    closed = true;
+                }
+            }
+            else if (text[pos] == '\\')
+            {
+                if (pos + 1 < end && text[pos + 1] == '\n')
+                    walk.escapedNewlines++;
+                pos += 2;
+            }
+            else
+                pos++;
+        }
+        walk.inside = inside;
+        if (!closed)
+            walk.escapedBeforeClose = walk.escapedNewlines;
+        return walk;
+    }
+
+    inline int countNewlines(const char *text, size_t begin, size_t end)
+    {
+        return (int)count(text + begin, text + end, '\n');
+    }
+}
+
+// Tokenizes the whole buffer using `threads` workers (0 = hardware concurrency).
+// Produces exactly the tokens, symbol ids and line numbers Lexer::tokenize() would.
+inline vector<Token> tokenizeParallel(SourceBuffer &source, unsigned threads = 0, size_t chunkBytes = 1 << 20)
+{
+    using namespace parallel_lex;
+    string_view src = source.text();
+    const char *text = src.data();
+    if (threads == 0)
+        threads = max(1u, thread::hardware_concurrency());
+    if (threads == 1 || src.size() <= chunkBytes)
+        return Lexer(source).tokenize();
+
+    // Chunk boundaries: the first newline at or after each multiple of chunkBytes
+    vector<ChunkScan> chunks;
+    for (size_t begin = 0; begin < src.size();)
+    {
+        size_t end = begin + chunkBytes;
+        if (end >= src.size())
+            end = src.size();
+        else
+        {
+            const void *newline = memchr(text + end, '\n', src.size() - end);
+            end = newline ? (const char *)newline - text + 1 : src.size();
+        }
+        ChunkScan chunk;
+        chunk.begin = begin;
+        chunk.end = end;
+        chunks.push_back(chunk);
+        begin = end;
+    }
+
+    // Pre-pass: string state transfer and newline count per chunk
+    parallelFor(chunks.size(), threads, [&](size_t i)
+                {
+        ChunkScan &c = chunks[i];
+        c.newlines = countNewlines(text, c.begin, c.end);
+        c.fromOutside = followStrings(text, c.begin, c.end, false);
+        c.fromInside = followStrings(text, c.begin, c.end, true); });
+
+    // Where each chunk's first token starts, and on which line
+    vector<size_t> starts(chunks.size());
+    vector<int> lines(chunks.size());
+    bool inside = false;
+    int line = 1;
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        const ChunkScan &c = chunks[i];
+        const StringWalk &walk = inside ? c.fromInside : c.fromOutside;
+        starts[i] = inside ? walk.firstClose : c.begin;
+        lines[i] = line + (inside ? countNewlines(text, c.begin, walk.firstClose) - walk.escapedBeforeClose : 0);
+        inside = walk.inside;
+        line += c.newlines - walk.escapedNewlines;
+    }
+
+    // Lex the chunks. Strings that run past a chunk end are finished by the chunk they start in.
+    vector<ChunkResult> results(chunks.size());
+    parallelFor(chunks.size(), threads, [&](size_t i)
+                {
+        ChunkResult &r = results[i];
+        Lexer lexer(source, starts[i], chunks[i].end, lines[i], r.names);
+        r.tokens.reserve((chunks[i].end - chunks[i].begin) / 4);
+        do
+        {
+            r.tokens.push_back(lexer.nextToken());
+        } while (r.tokens.back().type != T_EOF);
+        r.errorMessage = lexer.errorMessage;
+        r.errorLine = lexer.errorLine; });
+
+    for (const ChunkResult &r : results)
+    {
+        if (!r.errorMessage.empty())
+        {
+            cout << "Lexical error at line " << r.errorLine << ": " << r.errorMessage << endl;
+            exit(1);
+        }
+    }
+
+    // Map chunk-local symbol ids to global ones (in chunk order, so ids are assigned
+    // in first-occurrence order exactly as a sequential run would), then stitch
+    vector<vector<SymbolId>> remap(results.size());
+    vector<size_t> offsets(results.size() + 1, 0);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        for (SymbolId id = 0; id < results[i].names.size(); id++)
+            remap[i].push_back(symbols.intern(results[i].names.name(id)));
+        bool last = i + 1 == results.size();
+        offsets[i + 1] = offsets[i] + results[i].tokens.size() - (last ? 0 : 1); // drop inner EOFs
+    }
+
+    vector<Token> tokens(offsets.back());
+    parallelFor(results.size(), threads, [&](size_t i)
+                {
+        Token *out = tokens.data() + offsets[i];
+        for (size_t k = 0; k < offsets[i + 1] - offsets[i]; k++)
+        {
+            out[k] = results[i].tokens[k];
+            if (out[k].symbol != NoSymbol)
+                out[k].symbol = remap[i][out[k].symbol];
+        } });
+    return tokens;
+}
@@ -0,0 +1,372 @@
+#pragma once
+
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+// Peephole optimization of generated machine code.
+//
+// Each rule is declarative: a window of consecutive instruction patterns and the
+// instructions that replace it. In a pattern, $name matches one operand (text up
+// to a space, comma or colon) and must match the same text everywhere it occurs;
+// in a replacement it writes the bound text back, and $~name writes the inverse of
+// a bound condition code. Two kinds of pattern line take no place in the window:
+// "@$L pattern" matches the first instruction after label $L, and "!$L" holds when
+// no jump refers to label $L. Replacements fill the last places of the window, so
+// a label ending it stays where it is.
+//
+// Every rule is tried at every instruction, in rounds, until a round changes
+// nothing. The optimizer counts how often each rule applied.
+
+struct PeepholeRule
+{
+    const char *name;
+    vector<const char *> pattern;
+    vector<const char *> replacement; // never longer than the window
+};
+
+inline const vector<PeepholeRule> &peepholeRules()
+{
+    static const vector<PeepholeRule> rules = {
+        {"self move", {"MOV $a, $a"}, {}},
+        {"move back", {"MOV $a, $b", "MOV $b, $a"}, {"MOV $a, $b"}},
+        {"jump to next", {"J$cc $L", "$L:"}, {"$L:"}},
+        {"branch over jump", {"J$cc $L", "JMP $M", "$L:"}, {"J$~cc $M", "$L:"}},
+        {"jump to jump", {"J$cc $L", "@$L JMP $M"}, {"J$cc $M"}},
+        {"jump after jump", {"JMP $L", "JMP $M"}, {"JMP $L"}},
+        {"unused label", {"$L:", "!$L"}, {}},
+        // SETcc leaves the flags of the comparison that set it
+        {"test of set", {"SET$cc $t", "CMP $t, 0", "JNE $L"}, {"SET$cc $t", "J$cc $L"}},
+        {"test of clear", {"SET$cc $t", "CMP $t, 0", "JE $L"}, {"SET$cc $t", "J$~cc $L"}},
+    };
+    return rules;
+}
+
+class PeepholeOptimizer
+{
+public:
+    vector<size_t> hits; // per rule in peepholeRules()
+
+    PeepholeOptimizer() : hits(peepholeRules().size(), 0) {}
+
+    // Rewrites code made of entries that each end in '\n' at the offsets in ends;
+    // an entry may hold several lines. Entries left empty are dropped. Returns how
+    // many lines were removed.
+    size_t run(string &code, vector<size_t> &ends)
+    {
+        lines.clear();
+        size_t start = 0;
+        for (uint32_t entry = 0; entry < ends.size(); entry++)
+        {
+            for (size_t newline; (newline = code.find('\n', start)) < ends[entry]; start = newline + 1)
+                lines.push_back({string_view(code).substr(start, newline - start), entry});
+            lines.push_back({string_view(code).substr(start, ends[entry] - start), entry});
+            start = ends[entry] + 1;
+        }
+        size_t before = lines.size();
+
+        for (int round = 0; round < MaxRounds; round++)
+            if (!runRound())
+                break;
+
+        string rewritten;
+        rewritten.reserve(code.size());
+        vector<size_t> rewrittenEnds;
+        for (size_t i = 0; i < lines.size(); i++)
+        {
+            rewritten += lines[i].text;
+            if (i + 1 == lines.size() || lines[i + 1].entry != lines[i].entry)
+                rewrittenEnds.push_back(rewritten.size());
+            rewritten += '\n';
+        }
+        size_t removed = before - lines.size();
+        code = move(rewritten);
+        ends = move(rewrittenEnds);
+        arena.clear();
+        return removed;
+    }
+
+private:
+    // Jumps that go around in a cycle can be retargeted forever
+    static constexpr int MaxRounds = 32;
+    static constexpr size_t MaxBindings = 8;
+    static constexpr uint32_t NoLabel = 0xFFFFFFFFu;
+    static constexpr size_t NoLine = ~size_t(0);
+
+    struct Line
+    {
+        string_view text;
+        uint32_t entry; // the generated entry the line belongs to
+    };
+
+    struct Binding
+    {
+        string_view name, value;
+    };
+
+    vector<Line> lines;
+    vector<bool> dead;
+    deque<string> arena; // text of rewritten lines
+    // Indexed by label number; the code generator names labels LN
+    vector<size_t> labelLine;
+    vector<int> references; // jumps to each label
+    Binding bindings[MaxBindings];
+    size_t bound = 0;
+    vector<size_t> window;
+    vector<string_view> replaced;
+    string scratch;
+
+    static bool isLabel(string_view line)
+    {
+        return !line.empty() && line.back() == ':' && line.find(' ') == string_view::npos;
+    }
+
+    // N for a label spelled LN, NoLabel for anything else
+    static uint32_t labelNumber(string_view name)
+    {
+        uint32_t number = 0;
+        if (name.size() < 2 || name[0] != 'L' ||
+            from_chars(name.data() + 1, name.data() + name.size(), number).ptr != name.data() + name.size())
+            return NoLabel;
+        return number;
+    }
+
+    static bool isOperandChar(char c)
+    {
+        return c != ' ' && c != ',' && c != ':';
+    }
+
+    static string_view variableName(string_view text, size_t &p)
+    {
+        size_t start = p;
+        while (p < text.size() && (isalnum((unsigned char)text[p]) || text[p] == '_'))
+            p++;
+        return text.substr(start, p - start);
+    }
+
+    const string_view *lookup(string_view name) const
+    {
+        for (size_t k = 0; k < bound; k++)
+            if (bindings[k].name == name)
+                return &bindings[k].value;
+        return nullptr;
+    }
+
+    bool match(string_view pattern, string_view text)
+    {
+        size_t p = 0, t = 0;
+        while (p < pattern.size())
+        {
+            if (pattern[p] != '$')
+            {
+                if (t == text.size() || text[t] != pattern[p])
+                    return false;
+                p++, t++;
+                continue;
+            }
+            p++;
+            string_view name = variableName(pattern, p);
+            size_t end = t;
+            while (end < text.size() && isOperandChar(text[end]))
+                end++;
+            string_view value = text.substr(t, end - t);
+            if (value.empty())
+                return false;
+            if (const string_view *previous = lookup(name))
+            {
+                if (*previous != value)
+                    return false;
+            }
+            else if (bound < MaxBindings)
+                bindings[bound++] = {name, value};
+            else
+                return false;
+            t = end;
+        }
+        return t == text.size();
+    }
+
+    static string_view invertedCondition(string_view cc)
+    {
+        static const char *const pairs[][2] = {{"E", "NE"}, {"NE", "E"}, {"L", "GE"}, {"GE", "L"}, {"G", "LE"}, {"LE", "G"}};
+        for (const auto &pair : pairs)
+            if (cc == pair[0])
+                return pair[1];
+        return {};
+    }
+
+    // Writes a replacement or label template into scratch; false if it cannot be filled
+    bool substitute(string_view pattern)
+    {
+        scratch.clear();
+        for (size_t p = 0; p < pattern.size();)
+        {
+            if (pattern[p] != '$')
+            {
+                scratch += pattern[p++];
+                continue;
+            }
+            bool invert = ++p < pattern.size() && pattern[p] == '~';
+            if (invert)
+                p++;
+            const string_view *value = lookup(variableName(pattern, p));
+            if (!value)
+                return false;
+            string_view text = invert ? invertedCondition(*value) : *value;
+            if (text.empty())
+                return false;
+            scratch += text;
+        }
+        return true;
+    }
+
+    // Adds delta to the reference count of every label a jump or jump table names
+    void countReferences(string_view line, int delta)
+    {
+        if (line.empty() || line[0] != 'J')
+            return;
+        size_t space = line.find(' ');
+        int skip = line.substr(0, space) == "JMPTAB" ? 2 : 0; // selector and low bound
+        while (space != string_view::npos)
+        {
+            size_t start = line.find_first_not_of(' ', space + 1);
+            space = line.find(',', start);
+            if (skip > 0)
+                skip--;
+            else
+            {
+                uint32_t label = labelNumber(line.substr(start, space - start));
+                if (label != NoLabel)
+                {
+                    if (label >= references.size())
+                        references.resize(label + 1, 0);
+                    references[label] += delta;
+                }
+            }
+        }
+    }
+
+    // First live instruction after a label, or lines.size()
+    size_t targetOf(string_view label) const
+    {
+        uint32_t number = labelNumber(label);
+        if (number >= labelLine.size() || labelLine[number] == NoLine)
+            return lines.size();
+        size_t i = labelLine[number] + 1;
+        while (i < lines.size() && (dead[i] || isLabel(lines[i].text)))
+            i++;
+        return i;
+    }
+
+    bool apply(const PeepholeRule &rule, size_t i)
+    {
+        char first = rule.pattern[0][0];
+        if (first != '$' && (lines[i].text.empty() || lines[i].text[0] != first))
+            return false;
+        bound = 0;
+        window.clear();
+        size_t next = i;
+        for (const char *line : rule.pattern)
+        {
+            string_view pattern = line;
+            if (pattern[0] == '@')
+            {
+                size_t space = pattern.find(' ');
+                if (!substitute(pattern.substr(1, space - 1)))
+                    return false;
+                size_t target = targetOf(scratch);
+                if (target == lines.size() || !match(pattern.substr(space + 1), lines[target].text))
+                    return false;
+                continue;
+            }
+            if (pattern[0] == '!')
+            {
+                if (!substitute(pattern.substr(1)))
+                    return false;
+                uint32_t label = labelNumber(scratch);
+                if (label == NoLabel || (label < references.size() && references[label] > 0))
+                    return false;
+                continue;
+            }
+            while (next < lines.size() && dead[next])
+                next++;
+            if (next == lines.size() || !match(pattern, lines[next].text))
+                return false;
+            window.push_back(next++);
+        }
+
+        // Fill the last places of the window; a rewrite that changes nothing does not count
+        size_t keep = window.size() - rule.replacement.size();
+        bool changed = keep > 0;
+        replaced.clear();
+        for (size_t k = 0; k < rule.replacement.size(); k++)
+        {
+            if (!substitute(rule.replacement[k]))
+                return false;
+            string_view &text = lines[window[keep + k]].text;
+            if (text != scratch)
+            {
+                arena.push_back(scratch);
+                replaced.push_back(arena.back());
+                changed = true;
+            }
+            else
+                replaced.push_back(text);
+        }
+        if (!changed)
+            return false;
+        for (size_t k = 0; k < keep; k++)
+        {
+            dead[window[k]] = true;
+            countReferences(lines[window[k]].text, -1);
+        }
+        for (size_t k = 0; k < replaced.size(); k++)
+        {
+            countReferences(lines[window[keep + k]].text, -1);
+            lines[window[keep + k]].text = replaced[k];
+            countReferences(replaced[k], 1);
+        }
+        return true;
+    }
+
+    bool runRound()
+    {
+        const vector<PeepholeRule> &rules = peepholeRules();
+        dead.assign(lines.size(), false);
+        labelLine.clear();
+        references.clear();
+        for (size_t i = 0; i < lines.size(); i++)
+            if (isLabel(lines[i].text))
+            {
+                uint32_t label = labelNumber(lines[i].text.substr(0, lines[i].text.size() - 1));
+                if (label == NoLabel)
+                    continue;
+                if (label >= labelLine.size())
+                    labelLine.resize(label + 1, NoLine);
+                labelLine[label] = i;
+            }
+            else
+                countReferences(lines[i].text, 1);
+
+        bool changed = false;
+        for (size_t i = 0; i < lines.size(); i++)
+            for (size_t r = 0; r < rules.size() && !dead[i]; r++)
+                if (apply(rules[r], i))
+                {
+                    hits[r]++;
+                    changed = true;
+                }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < lines.size(); i++)
+            if (!dead[i])
+                lines[kept++] = lines[i];
+        lines.resize(kept);
+        return changed;
+    }
+};
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Deterministic generator of synthetic programs for benchmarking the compiler.
+// The same shape, size and seed always produce the same text, on every platform
+// (it uses its own xorshift generator rather than <random> distributions).
+//
+// Generated programs stay inside what the whole pipeline accepts: every declared
+// name is globally unique (the symbol table has a single scope), conditions
+// compare two operands with one of the six relational operators, string
+// literals contain no spaces, and `break` only ends switch cases, which would
+// otherwise fall through.
+//
+// Every program starts from `seed`, computed by a short loop. The optimizer does
+// not evaluate loops, so it cannot know seed's value, and the code computed from
+// it stays in the program for the later phases to work on.
+
+enum ProgramShape
+{
+    SHAPE_DECLARATIONS, // many int/bool/string declarations with initializers
+    SHAPE_NESTING,      // deeply nested if/else and while blocks
+    SHAPE_ARITHMETIC,   // long arithmetic expressions with parentheses
+    SHAPE_SWITCH,       // wide switch statements
+    SHAPE_FUNCTIONS,    // many small func bodies
+    SHAPE_STRUCTS,      // big structs and member assignments
+    SHAPE_MIXED,        // a bit of everything
+    SHAPE_COUNT
+};
+
+inline const char *shapeName(ProgramShape shape)
+{
+    static const char *const names[SHAPE_COUNT] = {"declarations", "nesting", "arithmetic", "switch",
+                                                   "functions", "structs", "mixed"};
+    return names[shape];
+}
+
+// SHAPE_COUNT if `name` is not a shape
+inline ProgramShape shapeFromName(const string &name)
+{
+    for (int shape = 0; shape < SHAPE_COUNT; shape++)
+        if (name == shapeName((ProgramShape)shape))
+            return (ProgramShape)shape;
+    return SHAPE_COUNT;
+}
+
+class ProgramGenerator
+{
+public:
+    // `width` is the operand count of long expressions, the case count of switches
+    // and the member count of structs; `depth` is the nesting depth of blocks.
+    explicit ProgramGenerator(uint32_t seed = 1, int width = 64, int depth = 48)
+        : state(seed ? seed : 1), width(width), depth(depth) {}
+
+    // Roughly `units` statements of the given shape
+    string generate(ProgramShape shape, size_t units)
+    {
+        out.clear();
+        variables.clear();
+        nameCounter = 0;
+        opaqueSeed();
+        switch (shape)
+        {
+        case SHAPE_DECLARATIONS:
+            for (size_t i = 0; i < units; i++)
+                declaration();
+            break;
+        case SHAPE_NESTING:
+            for (size_t done = 0; done < units; done += depth * 2)
+                nested(depth);
+            break;
+        case SHAPE_ARITHMETIC:
+            for (size_t i = 0; i < units; i++)
+                assignment(width);
+            break;
+        case SHAPE_SWITCH:
+            for (size_t done = 0; done < units; done += width)
+                switchStatement();
+            break;
+        case SHAPE_FUNCTIONS:
+            for (size_t done = 0; done < units; done += 6)
+                function();
+            break;
+        case SHAPE_STRUCTS:
+            for (size_t done = 0; done < units; done += width * 2)
+                structure();
+            break;
+        case SHAPE_MIXED:
+        default:
+            for (size_t done = 0; done < units; done += 16)
+            {
+                declaration();
+                declaration();
+                assignment(8);
+                nested(3);
+                if (next(4) == 0)
+                    function();
+                if (next(8) == 0)
+                    switchStatement();
+            }
+            break;
+        }
+        return out;
+    }
+
+private:
+    uint32_t state;
+    int width;
+    int depth;
+    string out;
+    vector<string> variables; // int variables in scope for expressions
+    size_t nameCounter = 0;
+
+    uint32_t next(uint32_t bound)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state % bound;
+    }
+
+    string freshName(const char *prefix)
+    {
+        return prefix + to_string(nameCounter++);
+    }
+
+    void indent(int level)
+    {
+        out.append(level * 4, ' ');
+    }
+
+    void declare(const char *type, const string &name, const string &value, int level = 0)
+    {
+        indent(level);
+        out += type;
+        out += ' ';
+        out += name;
+        if (!value.empty())
+            out += " = " + value;
+        out += ";\n";
+        if (string(type) == "int")
+            variables.push_back(name);
+    }
+
+    // seed and step, accumulated in a loop
+    void opaqueSeed()
+    {
+        declare("int", "seed", "1");
+        declare("int", "step", "0");
+        out += "while (step < 8) {\n";
+        out += "    seed = seed * 31 + step;\n";
+        out += "    step = step + 1;\n";
+        out += "}\n";
+    }
+
+    string operand()
+    {
+        if (next(3) == 0)
+            return to_string(next(1000));
+        return variable();
+    }
+
+    string expression(int operands)
+    {
+        static const char *const ops[] = {" + ", " - ", " * ", " / "};
+        string text = operand();
+        for (int i = 1; i < operands; i++)
+        {
+            text += ops[next(4)];
+            if (i + 2 < operands && next(5) == 0)
+            {
+                text += "(" + operand() + ops[next(2)] + operand() + ")";
+                i++;
+            }
+            else
+                text += operand();
+        }
+        return text;
+    }
+
+    string variable()
+    {
+        return variables[next((uint32_t)variables.size())];
+    }
+
+    // A variable against a literal, so no outcome is known before the program runs
+    string condition()
+    {
+        static const char *const ops[] = {" < ", " > ", " == ", " != ", " <= ", " >= "};
+        return variable() + ops[next(6)] + to_string(next(1000));
+    }
+
+    void declaration(int level = 0)
+    {
+        switch (next(4))
+        {
+        case 0:
+            declare("bool", freshName("flag"), next(2) ? "true" : "false", level);
+            break;
+        case 1:
+            declare("string", freshName("text"), "\"s" + to_string(next(100)) + "\"", level);
+            break;
+        default:
+            declare("int", freshName("v"), expression(1 + next(3)), level);
+            break;
+        }
+    }
+
+    void assignment(int operands, int level = 0)
+    {
+        indent(level);
+        out += variable() + " = " + expression(operands) + ";\n";
+    }
+
+    void nested(int levels, int level = 0)
+    {
+        indent(level);
+        out += (next(2) ? "if (" : "while (") + condition() + ") {\n";
+        assignment(3, level + 1);
+        if (levels > 1)
+            nested(levels - 1, level + 1);
+        indent(level);
+        out += "}\n";
+    }
+
+    void switchStatement()
+    {
+        out += "switch (" + variable() + ") {\n";
+        for (int i = 0; i < width; i++)
+        {
+            // A case holds one statement, so the break shares a block with it
+            out += "case " + to_string(i) + ": {\n";
+            assignment(2, 1);
+            indent(1);
+            out += "break;\n";
+            out += "}\n";
+        }
+        out += "default:\n";
+        assignment(2, 1);
+        out += "}\n";
+    }
+
+    void function()
+    {
+        out += "func " + freshName("f") + "() {\n";
+        declare("int", freshName("local"), expression(3), 1);
+        assignment(4, 1);
+        nested(2, 1);
+        indent(1);
+        out += "return " + expression(2) + ";\n";
+        out += "}\n";
+    }
+
+    void structure()
+    {
+        string name = freshName("S");
+        vector<string> members;
+        out += "struct " + name + " {\n";
+        for (int i = 0; i < width; i++)
+        {
+            members.push_back(freshName("m"));
+            out += "    int " + members.back() + ";\n";
+        }
+        out += "};\n";
+        string instance = freshName("r");
+        for (const string &member : members)
+            out += instance + "." + member + " = " + expression(2) + ";\n";
+    }
+};
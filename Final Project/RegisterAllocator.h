@@ -0,0 +1,323 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include "CFG.h"
+#include "IR.h"
+using namespace std;
+
+// Linear-scan register allocation for IR temporaries.
+//
+// Every temporary gets one live interval: the range of instruction indices from
+// the first point where it is live to the last, in program order. Temporaries
+// used only in their defining block span their definition to their last use;
+// the others are found live in and out of blocks by a backward dataflow over the
+// control-flow graph, and their interval covers every block they are live
+// through, so a value carried around a loop is kept for the whole loop.
+//
+// Intervals are visited by start point. Each takes a free register; with none
+// left, whichever of it and the active intervals ends last is spilled to a stack
+// slot for its whole lifetime. A copy from a temporary that dies at the copy
+// prefers the source's register, so the move disappears. Variables stay in memory.
+
+// The registers available to the allocator, in order of preference
+struct RegisterFile
+{
+    vector<SymbolId> registers;
+
+    RegisterFile(initializer_list<const char *> names)
+    {
+        for (const char *name : names)
+            registers.push_back(symbols.intern(name));
+    }
+
+    // Comma separated register names, e.g. "rbx,rcx,rsi"
+    explicit RegisterFile(const string &names)
+    {
+        size_t start = 0;
+        while (start <= names.size())
+        {
+            size_t comma = min(names.find(',', start), names.size());
+            if (comma > start)
+                registers.push_back(symbols.intern(string_view(names).substr(start, comma - start)));
+            start = comma + 1;
+        }
+    }
+
+    // x86-64 general purpose registers. rsp and rbp hold the frame; rax and rdx are
+    // left for division and return values, and r11 for memory-to-memory moves.
+    static RegisterFile x86_64()
+    {
+        return {"rbx", "rcx", "rsi", "rdi", "r8", "r9", "r10", "r12", "r13", "r14", "r15"};
+    }
+};
+
+struct RegisterAllocation
+{
+    vector<Operand> location; // per temporary: OP_REG, OP_SLOT, or OP_NONE if it never occurs
+    uint32_t temporaries = 0, registersUsed = 0, spilled = 0, stackSlots = 0, coalesced = 0;
+
+    // Where an operand lives after allocation; anything but an allocated temporary is unchanged
+    Operand locate(Operand operand) const
+    {
+        if (operand.kind == OP_TEMP && operand.id < location.size() && location[operand.id].kind != OP_NONE)
+            return location[operand.id];
+        return operand;
+    }
+};
+
+class RegisterAllocator
+{
+public:
+    explicit RegisterAllocator(RegisterFile file = RegisterFile::x86_64()) : file(move(file)) {}
+
+    RegisterAllocation allocate(const vector<IrInstr> &code)
+    {
+        RegisterAllocation result;
+        buildIntervals(code);
+        scan(code, result);
+        for (const IrInstr &instr : code)
+            if (instr.opcode == IR_COPY && instr.dstKind == OP_TEMP && instr.aKind == OP_TEMP &&
+                instr.dst != instr.a && result.locate(instr.dest()) == result.locate(instr.left()))
+                result.coalesced++;
+        return result;
+    }
+
+private:
+    struct Interval
+    {
+        uint32_t temp, start, end; // instruction indices, both inclusive
+    };
+
+    static constexpr uint32_t NoPosition = 0xFFFFFFFFu;
+
+    RegisterFile file;
+    vector<uint32_t> first, last; // per temporary: live range hull
+    vector<Interval> intervals;
+
+    void extend(uint32_t temp, uint32_t position)
+    {
+        first[temp] = min(first[temp], position);
+        last[temp] = max(last[temp], position);
+    }
+
+    void buildIntervals(const vector<IrInstr> &code)
+    {
+        uint32_t temps = 0;
+        for (const IrInstr &instr : code)
+            for (Operand operand : {instr.dest(), instr.left(), instr.right()})
+                if (operand.kind == OP_TEMP)
+                    temps = max(temps, operand.id + 1);
+        first.assign(temps, NoPosition);
+        last.assign(temps, 0);
+        for (uint32_t i = 0; i < code.size(); i++)
+            for (Operand operand : {code[i].dest(), code[i].left(), code[i].right()})
+                if (operand.kind == OP_TEMP)
+                    extend(operand.id, i);
+        extendAcrossBlocks(code, temps);
+
+        // Counting sort by start point; ties stay in temporary order
+        vector<uint32_t> offset(code.size() + 1, 0);
+        uint32_t live = 0;
+        for (uint32_t t = 0; t < temps; t++)
+            if (first[t] != NoPosition)
+            {
+                offset[first[t] + 1]++;
+                live++;
+            }
+        for (size_t i = 1; i < offset.size(); i++)
+            offset[i] += offset[i - 1];
+        intervals.resize(live);
+        for (uint32_t t = 0; t < temps; t++)
+            if (first[t] != NoPosition)
+                intervals[offset[first[t]]++] = {t, first[t], last[t]};
+    }
+
+    // Liveness of the temporaries that cross block boundaries, as bit sets over
+    // their dense numbering; each block they are live into or out of widens the hull
+    void extendAcrossBlocks(const vector<IrInstr> &code, uint32_t temps)
+    {
+        ControlFlowGraph cfg(code);
+        size_t blocks = cfg.blockCount();
+        vector<uint32_t> home(temps, NoBlock), global(temps, NoPosition);
+        vector<uint32_t> globals; // dense number -> temporary
+        for (BlockId b = 0; b < blocks; b++)
+            for (uint32_t i = cfg.block(b).begin; i < cfg.block(b).end; i++)
+                for (Operand operand : {code[i].dest(), code[i].left(), code[i].right()})
+                    if (operand.kind == OP_TEMP)
+                    {
+                        if (home[operand.id] == NoBlock)
+                            home[operand.id] = b;
+                        else if (home[operand.id] != b && global[operand.id] == NoPosition)
+                        {
+                            global[operand.id] = globals.size();
+                            globals.push_back(operand.id);
+                        }
+                    }
+        if (globals.empty())
+            return;
+
+        size_t words = (globals.size() + 63) / 64;
+        vector<uint64_t> upward(blocks * words, 0), defined(blocks * words, 0);
+        vector<uint64_t> liveIn(blocks * words, 0), liveOut(blocks * words, 0);
+        for (BlockId b = 0; b < blocks; b++)
+        {
+            uint64_t *use = &upward[b * words], *def = &defined[b * words];
+            for (uint32_t i = cfg.block(b).begin; i < cfg.block(b).end; i++)
+            {
+                for (Operand operand : {code[i].left(), code[i].right()})
+                    if (operand.kind == OP_TEMP && global[operand.id] != NoPosition)
+                    {
+                        uint32_t g = global[operand.id];
+                        if (!(def[g / 64] >> (g % 64) & 1))
+                            use[g / 64] |= uint64_t(1) << (g % 64);
+                    }
+                if (writesDest(code[i].opcode) && code[i].dstKind == OP_TEMP && global[code[i].dst] != NoPosition)
+                    def[global[code[i].dst] / 64] |= uint64_t(1) << (global[code[i].dst] % 64);
+            }
+        }
+
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (BlockId b : cfg.postorder())
+            {
+                uint64_t *out = &liveOut[b * words], *in = &liveIn[b * words];
+                for (BlockId s : cfg.successors(b))
+                    for (size_t w = 0; w < words; w++)
+                        out[w] |= liveIn[s * words + w];
+                for (size_t w = 0; w < words; w++)
+                {
+                    uint64_t next = upward[b * words + w] | (out[w] & ~defined[b * words + w]);
+                    if (next != in[w])
+                    {
+                        in[w] = next;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        for (BlockId b = 0; b < blocks; b++)
+        {
+            const BasicBlock &block = cfg.block(b);
+            if (block.begin == block.end)
+                continue;
+            for (size_t w = 0; w < words; w++)
+            {
+                for (uint64_t bits = liveIn[b * words + w]; bits; bits &= bits - 1)
+                    extend(globals[w * 64 + __builtin_ctzll(bits)], block.begin);
+                for (uint64_t bits = liveOut[b * words + w]; bits; bits &= bits - 1)
+                    extend(globals[w * 64 + __builtin_ctzll(bits)], block.end - 1);
+            }
+        }
+    }
+
+    // Poletto and Sarkar's scan; the active list is kept sorted by end point
+    void scan(const vector<IrInstr> &code, RegisterAllocation &result)
+    {
+        uint32_t registers = file.registers.size();
+        result.temporaries = intervals.size();
+        result.location.assign(first.size(), Operand());
+        vector<Interval> active;
+        vector<bool> busy(registers, false), everUsed(registers, false);
+        vector<uint32_t> registerOf(first.size(), NoPosition);
+        vector<pair<uint32_t, uint32_t>> freeSlots; // slot, end of its last occupant
+        vector<pair<uint32_t, uint32_t>> slotEnds;  // end of the occupant, slot; a min-heap
+
+        for (const Interval &current : intervals)
+        {
+            // A register read by the instruction that defines this temporary can be
+            // reused for it: the operands are read before the result is written
+            const IrInstr &at = code[current.start];
+            bool definedHere = writesDest(at.opcode) && at.dstKind == OP_TEMP && at.dst == current.temp;
+            size_t expired = 0;
+            while (expired < active.size() &&
+                   (active[expired].end < current.start || (definedHere && active[expired].end == current.start)))
+                busy[registerOf[active[expired++].temp]] = false;
+            active.erase(active.begin(), active.begin() + expired);
+            while (!slotEnds.empty() && slotEnds.front().first < current.start)
+            {
+                freeSlots.push_back({slotEnds.front().second, slotEnds.front().first});
+                pop_heap(slotEnds.begin(), slotEnds.end(), greater<pair<uint32_t, uint32_t>>());
+                slotEnds.pop_back();
+            }
+
+            uint32_t chosen = NoPosition;
+            if (definedHere && at.opcode == IR_COPY && at.aKind == OP_TEMP && registerOf[at.a] != NoPosition &&
+                !busy[registerOf[at.a]])
+                chosen = registerOf[at.a]; // coalesce the copy
+            for (uint32_t r = 0; chosen == NoPosition && r < registers; r++)
+                if (!busy[r])
+                    chosen = r;
+
+            Interval placed = current;
+            if (chosen == NoPosition)
+            {
+                // Spill whichever interval ends last; it may be this one
+                if (!active.empty() && active.back().end > current.end)
+                {
+                    Interval victim = active.back();
+                    active.pop_back();
+                    chosen = registerOf[victim.temp];
+                    registerOf[victim.temp] = NoPosition;
+                    spill(victim, result, freeSlots, slotEnds);
+                }
+                else
+                {
+                    spill(current, result, freeSlots, slotEnds);
+                    continue;
+                }
+            }
+            busy[chosen] = everUsed[chosen] = true;
+            registerOf[placed.temp] = chosen;
+            result.location[placed.temp] = Operand(OP_REG, file.registers[chosen]);
+            active.insert(upper_bound(active.begin(), active.end(), placed, [](const Interval &x, const Interval &y)
+                                      { return x.end < y.end; }),
+                          placed);
+        }
+        result.registersUsed = count(everUsed.begin(), everUsed.end(), true);
+    }
+
+    // Gives an interval a stack slot no other live interval holds
+    static void spill(const Interval &interval, RegisterAllocation &result,
+                      vector<pair<uint32_t, uint32_t>> &freeSlots, vector<pair<uint32_t, uint32_t>> &slotEnds)
+    {
+        uint32_t slot = result.stackSlots;
+        for (size_t k = 0; k < freeSlots.size(); k++)
+            if (freeSlots[k].second < interval.start) // an interval spilled late started before now
+            {
+                slot = freeSlots[k].first;
+                freeSlots[k] = freeSlots.back();
+                freeSlots.pop_back();
+                break;
+            }
+        if (slot == result.stackSlots)
+            result.stackSlots++;
+        slotEnds.push_back({interval.end, slot});
+        push_heap(slotEnds.begin(), slotEnds.end(), greater<pair<uint32_t, uint32_t>>());
+        result.location[interval.temp] = Operand(OP_SLOT, slot);
+        result.spilled++;
+    }
+};
+
+// Operands the emitted code reads or writes in memory: variables, stack slots and,
+// without an allocation, every temporary
+inline size_t memoryOperands(const vector<IrInstr> &code, const RegisterAllocation *allocation = nullptr)
+{
+    size_t count = 0;
+    for (const IrInstr &instr : code)
+        for (Operand operand : {instr.dest(), instr.left(), instr.right()})
+        {
+            if (allocation)
+                operand = allocation->locate(operand);
+            if (operand.kind == OP_VAR || operand.kind == OP_TEMP || operand.kind == OP_SLOT)
+                count++;
+        }
+    return count;
+}
@@ -0,0 +1,464 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "CFG.h"
+#include "IR.h"
+using namespace std;
+
+// Static single assignment form of the IR.
+//
+// Construction places phis at the iterated dominance frontiers of each variable's
+// definitions (only for variables read in some block before being written there)
+// and renames every variable definition to a fresh temporary, walking the
+// dominator tree. Temporaries are already assigned once, so afterwards every
+// name has exactly one definition and def-use chains are plain lists.
+//
+// Destruction maps every version back to its variable and turns phi operands that
+// are not the variable itself into copies on the incoming edges, splitting edges
+// out of conditional branches. Mapping versions back is only valid while no two
+// versions of a variable are live at once: passes working on SSA may replace uses
+// with constants or other temporaries and delete instructions, but must not
+// replace a use of one version with another.
+class SsaForm
+{
+public:
+    explicit SsaForm(vector<IrInstr> &code) : code(code), graph(code)
+    {
+        build();
+    }
+
+    // The CFG of the SSA code; block ids match the code before construction
+    const ControlFlowGraph &cfg() const
+    {
+        return graph;
+    }
+
+    // Temporaries, including variable versions, have ids below this
+    uint32_t nameCount() const
+    {
+        return (uint32_t)variables.size();
+    }
+
+    // Variable a version stands for, or NoSymbol for ordinary temporaries
+    SymbolId variableOf(uint32_t name) const
+    {
+        return variables[name];
+    }
+
+    // Operands of a phi, one per predecessor of its block in cfg() order
+    Operand *phiOperands(const IrInstr &phi)
+    {
+        return phiArgs.data() + phi.a;
+    }
+
+    // Index of the instruction defining a name, or NoIndex
+    uint32_t definition(uint32_t name) const
+    {
+        return defs[name];
+    }
+
+    // Indices of the instructions reading a name, phis included
+    BlockList uses(uint32_t name) const
+    {
+        return {useList.data() + useOffset[name], useList.data() + useOffset[name + 1]};
+    }
+
+    uint32_t blockOf(uint32_t instruction) const
+    {
+        return instrBlock[instruction];
+    }
+
+    // Drops an instruction when the code leaves SSA form
+    void remove(uint32_t instruction)
+    {
+        removed[instruction] = true;
+    }
+
+    // Converts the code back to ordinary IR in place
+    void destruct();
+
+    static constexpr uint32_t NoIndex = 0xFFFFFFFFu;
+
+private:
+    vector<IrInstr> &code;
+    ControlFlowGraph graph;
+    vector<Operand> phiArgs;
+    vector<SymbolId> variables; // per name
+    vector<uint32_t> defs;      // per name
+    vector<uint32_t> useOffset; // per name, plus one
+    vector<uint32_t> useList;
+    vector<BlockId> instrBlock;
+    vector<bool> removed;
+    bool addedEntry = false; // a label was put in front so the entry has no predecessors
+    uint32_t nextId = 0;     // fresh temporary and label numbers
+
+    Operand freshTemp(SymbolId variable)
+    {
+        variables.push_back(variable);
+        return Operand(OP_TEMP, nextId++);
+    }
+
+    void build();
+    void rename(const DominatorTree &dominators);
+    void computeDefUse();
+};
+
+inline void SsaForm::build()
+{
+    if (code.empty())
+        return;
+
+    // Temporaries and labels share one numbering; fresh names go above both
+    for (const IrInstr &instr : code)
+        for (Operand operand : {instr.dest(), instr.left(), instr.right()})
+            if ((operand.kind == OP_TEMP || operand.kind == OP_LABEL) && operand.id >= nextId)
+                nextId = operand.id + 1;
+
+    // Renaming needs an entry block that nothing jumps back to
+    if (graph.predecessors(0).size() > 0)
+    {
+        code.insert(code.begin(), IrInstr(IR_LABEL, Operand(), Operand(OP_LABEL, nextId++)));
+        graph = ControlFlowGraph(code);
+        addedEntry = true;
+    }
+    variables.assign(nextId, NoSymbol);
+
+    DominatorTree dominators(graph);
+    BlockId blocks = (BlockId)graph.blockCount();
+
+    // Dominance frontiers
+    vector<vector<BlockId>> frontier(blocks);
+    for (BlockId b = 0; b < blocks; b++)
+    {
+        if (!graph.reachable(b) || graph.predecessors(b).size() < 2)
+            continue;
+        for (BlockId p : graph.predecessors(b))
+            for (BlockId runner = p; graph.reachable(runner) && runner != dominators.idom(b);
+                 runner = dominators.idom(runner))
+            {
+                if (frontier[runner].empty() || frontier[runner].back() != b)
+                    frontier[runner].push_back(b);
+                if (runner == dominators.idom(runner))
+                    break;
+            }
+    }
+
+    // Blocks defining each variable, and the variables read before written in a block
+    vector<vector<BlockId>> defBlocks(symbols.size());
+    vector<bool> global(symbols.size(), false);
+    vector<BlockId> written(symbols.size(), NoBlock);
+    for (BlockId b = 0; b < blocks; b++)
+    {
+        if (!graph.reachable(b))
+            continue;
+        for (uint32_t i = graph.block(b).begin; i < graph.block(b).end; i++)
+        {
+            const IrInstr &instr = code[i];
+            for (Operand read : {instr.left(), instr.right()})
+                if (read.kind == OP_VAR && written[read.id] != b)
+                    global[read.id] = true;
+            if (writesDest(instr.opcode) && instr.dstKind == OP_VAR && written[instr.dst] != b)
+            {
+                written[instr.dst] = b;
+                defBlocks[instr.dst].push_back(b);
+            }
+        }
+    }
+
+    // Phi placement on the iterated dominance frontier
+    vector<vector<SymbolId>> blockPhis(blocks);
+    vector<SymbolId> hasPhi(blocks, NoSymbol), queued(blocks, NoSymbol);
+    vector<BlockId> work;
+    for (SymbolId v = 0; v < defBlocks.size(); v++)
+    {
+        if (!global[v] || defBlocks[v].empty())
+            continue;
+        for (BlockId b : defBlocks[v])
+        {
+            queued[b] = v;
+            work.push_back(b);
+        }
+        while (!work.empty())
+        {
+            BlockId b = work.back();
+            work.pop_back();
+            for (BlockId f : frontier[b])
+            {
+                if (hasPhi[f] == v)
+                    continue;
+                hasPhi[f] = v;
+                blockPhis[f].push_back(v);
+                if (queued[f] != v)
+                {
+                    queued[f] = v;
+                    work.push_back(f);
+                }
+            }
+        }
+    }
+
+    // Insert the phis at the top of their blocks, after the label
+    vector<IrInstr> ssa;
+    ssa.reserve(code.size() + blocks);
+    for (BlockId b = 0; b < blocks; b++)
+    {
+        uint32_t i = graph.block(b).begin;
+        if (code[i].opcode == IR_LABEL)
+            ssa.push_back(code[i++]);
+        uint32_t incoming = (uint32_t)graph.predecessors(b).size();
+        for (SymbolId v : blockPhis[b])
+        {
+            ssa.push_back(IrInstr(IR_PHI, Operand(OP_VAR, v)));
+            ssa.back().a = (uint32_t)phiArgs.size();
+            ssa.back().b = incoming;
+            phiArgs.insert(phiArgs.end(), incoming, Operand(OP_VAR, v));
+        }
+        ssa.insert(ssa.end(), code.begin() + i, code.begin() + graph.block(b).end);
+    }
+    code.swap(ssa);
+    graph = ControlFlowGraph(code); // same blocks, shifted instruction ranges
+
+    rename(dominators);
+    computeDefUse();
+}
+
+// Walks the dominator tree keeping the current version of each variable, with an
+// undo log to restore it when leaving a subtree
+inline void SsaForm::rename(const DominatorTree &dominators)
+{
+    vector<Operand> current(symbols.size());
+    for (SymbolId v = 0; v < current.size(); v++)
+        current[v] = Operand(OP_VAR, v);
+    vector<pair<SymbolId, Operand>> undo;
+    vector<pair<BlockId, uint32_t>> stack = {{0, 0}}; // block, next child
+    vector<size_t> undoMark;
+
+    auto enter = [&](BlockId b)
+    {
+        undoMark.push_back(undo.size());
+        for (uint32_t i = graph.block(b).begin; i < graph.block(b).end; i++)
+        {
+            IrInstr &instr = code[i];
+            if (instr.opcode != IR_PHI)
+            {
+                if (instr.aKind == OP_VAR)
+                    instr.setLeft(current[instr.a]);
+                if (instr.bKind == OP_VAR)
+                    instr.setRight(current[instr.b]);
+            }
+            if ((writesDest(instr.opcode) || instr.opcode == IR_PHI) && instr.dstKind == OP_VAR)
+            {
+                SymbolId v = instr.dst;
+                undo.push_back({v, current[v]});
+                current[v] = freshTemp(v);
+                instr.setDest(current[v]);
+            }
+        }
+        for (BlockId s : graph.successors(b))
+        {
+            BlockList preds = graph.predecessors(s);
+            uint32_t j = 0;
+            while (preds.first[j] != b)
+                j++;
+            for (uint32_t i = graph.block(s).begin; i < graph.block(s).end; i++)
+            {
+                const IrInstr &phi = code[i];
+                if (phi.opcode == IR_LABEL)
+                    continue;
+                if (phi.opcode != IR_PHI)
+                    break;
+                SymbolId v = phi.dstKind == OP_VAR ? phi.dst : variables[phi.dst];
+                phiArgs[phi.a + j] = current[v];
+            }
+        }
+    };
+
+    enter(0);
+    while (!stack.empty())
+    {
+        auto &top = stack.back();
+        BlockList children = dominators.children(top.first);
+        if (top.second < children.size())
+        {
+            BlockId child = children.first[top.second++];
+            stack.push_back({child, 0});
+            enter(child);
+            continue;
+        }
+        for (size_t n = undoMark.back(); undo.size() > n; undo.pop_back())
+            current[undo.back().first] = undo.back().second;
+        undoMark.pop_back();
+        stack.pop_back();
+    }
+}
+
+inline void SsaForm::computeDefUse()
+{
+    uint32_t names = nameCount();
+    for (const IrInstr &instr : code)
+        if (instr.dstKind == OP_TEMP && instr.dst >= names)
+            names = instr.dst + 1;
+    variables.resize(names, NoSymbol);
+
+    defs.assign(names, NoIndex);
+    useOffset.assign(names + 1, 0);
+    instrBlock.assign(code.size(), NoBlock);
+    removed.assign(code.size(), false);
+    auto forEachRead = [&](uint32_t i, auto fn)
+    {
+        const IrInstr &instr = code[i];
+        if (instr.opcode == IR_PHI)
+        {
+            for (uint32_t j = 0; j < instr.b; j++)
+                fn(phiArgs[instr.a + j]);
+            return;
+        }
+        fn(instr.left());
+        fn(instr.right());
+    };
+    for (BlockId b = 0; b < graph.blockCount(); b++)
+        for (uint32_t i = graph.block(b).begin; i < graph.block(b).end; i++)
+        {
+            instrBlock[i] = b;
+            if (code[i].dstKind == OP_TEMP)
+                defs[code[i].dst] = i;
+            forEachRead(i, [&](Operand read)
+                        {
+                if (read.kind == OP_TEMP && read.id < names)
+                    useOffset[read.id + 1]++; });
+        }
+    for (uint32_t n = 0; n < names; n++)
+        useOffset[n + 1] += useOffset[n];
+    useList.resize(useOffset[names]);
+    vector<uint32_t> fill(useOffset.begin(), useOffset.end() - 1);
+    for (uint32_t i = 0; i < code.size(); i++)
+        forEachRead(i, [&](Operand read)
+                    {
+            if (read.kind == OP_TEMP && read.id < names)
+                useList[fill[read.id]++] = i; });
+}
+
+inline void SsaForm::destruct()
+{
+    if (code.empty())
+        return;
+    auto original = [&](Operand operand)
+    {
+        if (operand.kind == OP_TEMP && operand.id < variables.size() && variables[operand.id] != NoSymbol)
+            return Operand(OP_VAR, variables[operand.id]);
+        return operand;
+    };
+    for (IrInstr &instr : code)
+    {
+        if (instr.opcode == IR_PHI)
+        {
+            instr.setDest(original(instr.dest()));
+            continue;
+        }
+        instr.setDest(original(instr.dest()));
+        instr.setLeft(original(instr.left()));
+        instr.setRight(original(instr.right()));
+    }
+
+    // Copies each edge needs, gathered per predecessor and successor
+    BlockId blocks = (BlockId)graph.blockCount();
+    vector<vector<IrInstr>> insertBefore(code.size() + 1); // indexed by instruction
+    vector<IrInstr> splitBlocks;                           // appended after the code
+    for (BlockId b = 0; b < blocks; b++)
+    {
+        BlockList preds = graph.predecessors(b);
+        for (uint32_t j = 0; j < preds.size(); j++)
+        {
+            BlockId p = preds.first[j];
+            vector<pair<Operand, Operand>> copies; // destination, source
+            for (uint32_t i = graph.block(b).begin; i < graph.block(b).end; i++)
+            {
+                if (code[i].opcode == IR_LABEL)
+                    continue;
+                if (code[i].opcode != IR_PHI)
+                    break;
+                if (removed[i])
+                    continue;
+                Operand source = original(phiArgs[code[i].a + j]);
+                if (source != code[i].dest())
+                    copies.push_back({code[i].dest(), source});
+            }
+            if (copies.empty())
+                continue;
+
+            // Sequentialize the parallel copy; a cycle is broken with a temporary
+            vector<IrInstr> sequence;
+            while (!copies.empty())
+            {
+                size_t ready = copies.size();
+                for (size_t k = 0; k < copies.size() && ready == copies.size(); k++)
+                {
+                    bool readLater = false;
+                    for (size_t m = 0; m < copies.size(); m++)
+                        readLater |= m != k && copies[m].second == copies[k].first;
+                    if (!readLater)
+                        ready = k;
+                }
+                if (ready == copies.size())
+                {
+                    Operand saved(OP_TEMP, nextId++);
+                    sequence.push_back(IrInstr(IR_COPY, saved, copies[0].first));
+                    for (auto &copy : copies)
+                        if (copy.second == copies[0].first)
+                            copy.second = saved;
+                    continue;
+                }
+                sequence.push_back(IrInstr(IR_COPY, copies[ready].first, copies[ready].second));
+                copies.erase(copies.begin() + ready);
+            }
+
+            // Where the copies go depends on how control leaves the predecessor
+            uint32_t last = graph.block(p).end - 1;
+            const IrInstr &exit = code[last];
+            bool conditional = !removed[last] && (exit.opcode == IR_BRANCH || isCompareBranch(exit.opcode));
+            bool jumps = !removed[last] && exit.opcode == IR_JUMP;
+            // The edge past a function body starts before FUNC; the edge out of it
+            // must not run when the body is skipped, so its copies end the body
+            bool definition = (exit.opcode == IR_FUNC && p + 1 != b) || exit.opcode == IR_END_FUNC;
+            if (jumps || definition)
+                insertBefore[last].insert(insertBefore[last].end(), sequence.begin(), sequence.end());
+            else if (!conditional)
+                insertBefore[last + 1].insert(insertBefore[last + 1].end(), sequence.begin(), sequence.end());
+            else
+            {
+                // Fall-through edge: the copies run between the branch and the block
+                if (p + 1 == b)
+                    insertBefore[last + 1].insert(insertBefore[last + 1].end(), sequence.begin(), sequence.end());
+                // Taken edge: branch to a new block holding the copies
+                if (graph.blockOfLabel(jumpTarget(exit)) == b)
+                {
+                    Operand split(OP_LABEL, nextId++);
+                    splitBlocks.push_back(IrInstr(IR_LABEL, Operand(), split));
+                    splitBlocks.insert(splitBlocks.end(), sequence.begin(), sequence.end());
+                    splitBlocks.push_back(IrInstr(IR_JUMP, Operand(), Operand(OP_LABEL, jumpTarget(exit))));
+                    code[last].setDest(split);
+                }
+            }
+        }
+    }
+
+    vector<IrInstr> out;
+    out.reserve(code.size() + splitBlocks.size() + 2);
+    for (uint32_t i = 0; i <= code.size(); i++)
+    {
+        out.insert(out.end(), insertBefore[i].begin(), insertBefore[i].end());
+        if (i == code.size() || removed[i] || code[i].opcode == IR_PHI || (i == 0 && addedEntry))
+            continue;
+        out.push_back(code[i]);
+    }
+    if (!splitBlocks.empty())
+    {
+        // Keep the end of the program from falling into the split blocks
+        Operand end(OP_LABEL, nextId++);
+        out.push_back(IrInstr(IR_JUMP, Operand(), end));
+        out.insert(out.end(), splitBlocks.begin(), splitBlocks.end());
+        out.push_back(IrInstr(IR_LABEL, Operand(), end));
+    }
+    code.swap(out);
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+using namespace std;
+
+// Per-phase compile-time profiling for the compiler drivers (--time-report).
+//
+// Each phase records wall time, CPU time, growth of the process peak RSS and the
+// number of heap allocations made while it ran, plus an optional item count
+// (tokens, statements, instructions) used to derive a throughput figure.
+//
+// This header replaces the global operator new to count allocations, so it must be
+// included by exactly one translation unit; each driver is a single file.
+
+inline atomic<size_t> heapAllocations(0);
+
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    heapAllocations.fetch_add(1, memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+class TimeReport
+{
+public:
+    enum Format
+    {
+        TEXT,
+        JSON
+    };
+
+    struct Phase
+    {
+        string name;
+        double wallSeconds = 0;
+        double cpuSeconds = 0;
+        long peakRssDeltaKB = 0;
+        size_t allocations = 0;
+        vector<pair<string, size_t>> counts; // e.g. {"tokens", 1234}
+    };
+
+    // Starts timing a phase; it runs until end() is called
+    void begin(const string &name)
+    {
+        Phase phase;
+        phase.name = name;
+        phases.push_back(phase);
+        startWall = chrono::steady_clock::now();
+        startCpu = cpuSeconds();
+        startRss = peakRssKB();
+        startAllocations = heapAllocations.load(memory_order_relaxed);
+    }
+
+    void end()
+    {
+        Phase &phase = phases.back();
+        phase.allocations = heapAllocations.load(memory_order_relaxed) - startAllocations;
+        phase.peakRssDeltaKB = peakRssKB() - startRss;
+        phase.cpuSeconds = cpuSeconds() - startCpu;
+        phase.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - startWall).count();
+    }
+
+    // Attaches an item count to the most recent phase; reported as a rate as well
+    void count(const string &unit, size_t items)
+    {
+        phases.back().counts.push_back({unit, items});
+    }
+
+    void print(ostream &out, Format format) const
+    {
+        if (format == JSON)
+            printJson(out);
+        else
+            printText(out);
+    }
+
+private:
+    vector<Phase> phases;
+    chrono::steady_clock::time_point startWall;
+    double startCpu = 0;
+    long startRss = 0;
+    size_t startAllocations = 0;
+
+    static double cpuSeconds()
+    {
+#ifdef _WIN32
+        return double(clock()) / CLOCKS_PER_SEC;
+#else
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+               (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#endif
+    }
+
+    static long peakRssKB()
+    {
+#ifdef _WIN32
+        return 0;
+#else
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+        return usage.ru_maxrss;
+#endif
+#endif
+    }
+
+    static double rate(size_t items, double seconds)
+    {
+        return seconds > 0 ? items / seconds : 0;
+    }
+
+    void printText(ostream &out) const
+    {
+        Phase total;
+        total.name = "total";
+        // Wide enough for the longest phase name, such as an optimizer pass
+        int nameWidth = 20;
+        for (const Phase &phase : phases)
+            nameWidth = max(nameWidth, int(phase.name.size()) + 2);
+        out << "Time report" << endl;
+        out << left << setw(nameWidth) << "phase" << right << setw(12) << "wall ms" << setw(12) << "cpu ms"
+            << setw(14) << "peak RSS +KB" << setw(10) << "allocs" << "  throughput" << endl;
+        for (const Phase &phase : phases)
+        {
+            printTextRow(out, phase, nameWidth);
+            total.wallSeconds += phase.wallSeconds;
+            total.cpuSeconds += phase.cpuSeconds;
+            total.peakRssDeltaKB += phase.peakRssDeltaKB;
+            total.allocations += phase.allocations;
+        }
+        printTextRow(out, total, nameWidth);
+    }
+
+    static void printTextRow(ostream &out, const Phase &phase, int nameWidth)
+    {
+        out << left << setw(nameWidth) << phase.name << right << fixed << setprecision(3)
+            << setw(12) << phase.wallSeconds * 1000 << setw(12) << phase.cpuSeconds * 1000
+            << setw(14) << phase.peakRssDeltaKB << setw(10) << phase.allocations;
+        for (const auto &item : phase.counts)
+            out << "  " << item.second << " " << item.first << " (" << setprecision(0)
+                << rate(item.second, phase.wallSeconds) << " " << item.first << "/sec)" << setprecision(3);
+        out << defaultfloat << endl;
+    }
+
+    void printJson(ostream &out) const
+    {
+        out << "{\"phases\": [";
+        for (size_t i = 0; i < phases.size(); i++)
+        {
+            const Phase &phase = phases[i];
+            out << (i ? ", " : "") << "{\"name\": \"" << phase.name << "\""
+                << ", \"wall_ms\": " << phase.wallSeconds * 1000
+                << ", \"cpu_ms\": " << phase.cpuSeconds * 1000
+                << ", \"peak_rss_delta_kb\": " << phase.peakRssDeltaKB
+                << ", \"allocations\": " << phase.allocations;
+            for (const auto &item : phase.counts)
+            {
+                string key = item.first;
+                replace(key.begin(), key.end(), ' ', '_');
+                out << ", \"" << key << "\": " << item.second
+                    << ", \"" << key << "_per_sec\": " << rate(item.second, phase.wallSeconds);
+            }
+            out << "}";
+        }
+        out << "]}" << endl;
+    }
+};
+
+// Parses "--time-report" / "--time-report=text" / "--time-report=json".
+// Returns false if `arg` is not a time-report option.
+inline bool parseTimeReportOption(const string &arg, bool &enabled, TimeReport::Format &format)
+{
+    if (arg == "--time-report" || arg == "--time-report=text")
+        format = TimeReport::TEXT;
+    else if (arg == "--time-report=json")
+        format = TimeReport::JSON;
+    else
+        return false;
+    enabled = true;
+    return true;
+}
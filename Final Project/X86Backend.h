@@ -0,0 +1,740 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Compiler.h"
+#include "RegisterAllocator.h"
+using namespace std;
+
+// x86-64 backend: lowers the IR, after register allocation, to x86-64 machine
+// instructions, and prints those as GNU as source in Intel syntax that assembles
+// and links into a static executable:
+//   as prog.s -o prog.o && ld prog.o -o prog
+// X86Jit.h encodes the same instructions into memory and runs them in-process.
+//
+// Top-level code becomes main and every function its own global symbol, each
+// with a System V frame. rbp is the frame pointer; below it come the stack slots
+// of spilled temporaries ([rbp-8], ...), then one zero-initialized slot per
+// variable the function uses, then the callee-saved registers it allocates.
+// Nothing calls the functions (the language has no call expressions), and
+// _start calls main and exits with its return value as the status. Strings are
+// literals in .rodata and evaluate to their address.
+//
+// Three-address operations become two-address ones by computing into the
+// destination register when it is not the right operand, swapping the operands
+// of + and * when it is, and into rax otherwise. rax and rdx serve division and
+// return values, and r11 holds operands an instruction cannot encode (a second
+// memory operand, a 64-bit immediate, a string address); none is allocated.
+
+// Numbered as in the instruction encoding
+enum X86Register : uint8_t
+{
+    RAX,
+    RCX,
+    RDX,
+    RBX,
+    RSP,
+    RBP,
+    RSI,
+    RDI,
+    R8,
+    R9,
+    R10,
+    R11,
+    R12,
+    R13,
+    R14,
+    R15,
+    X86_REGISTER_COUNT
+};
+
+// Numbered as in the encodings of Jcc and SETcc
+enum X86Condition : uint8_t
+{
+    CC_A = 0x7,
+    CC_E = 0x4,
+    CC_NE = 0x5,
+    CC_L = 0xC,
+    CC_GE = 0xD,
+    CC_LE = 0xE,
+    CC_G = 0xF
+};
+
+struct X86Operand
+{
+    enum Kind : uint8_t
+    {
+        NONE,
+        REGISTER,     // reg, size bytes wide: 8, 4 or 1
+        FRAME_SLOT,   // qword ptr [rbp + value]
+        IMMEDIATE,    // value
+        LABEL,        // IR label number value
+        RETURN_LABEL, // epilogue of function number value
+        STRING,       // [rip + string literal number value]
+        TABLE,        // [rip + jump table number value]
+        TABLE_ENTRY   // dword ptr [r11 + rax*4]
+    };
+
+    Kind kind = NONE;
+    uint8_t reg = 0;
+    uint8_t size = 8;
+    int64_t value = 0;
+
+    bool operator==(const X86Operand &other) const
+    {
+        return kind == other.kind && reg == other.reg && size == other.size && value == other.value;
+    }
+    bool operator!=(const X86Operand &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+inline X86Operand x86Register(uint8_t reg, uint8_t size = 8)
+{
+    return {X86Operand::REGISTER, reg, size, 0};
+}
+
+inline X86Operand x86Operand(X86Operand::Kind kind, int64_t value)
+{
+    return {kind, 0, 8, value};
+}
+
+enum X86Opcode : uint8_t
+{
+    X86_LABEL,  // a:
+    X86_MOV,
+    X86_MOVZX,  // 32-bit register from an 8-bit one
+    X86_MOVSXD, // 64-bit register from 32-bit memory
+    X86_LEA,
+    X86_ADD,
+    X86_SUB,
+    X86_IMUL,   // a *= b, or a = b * c for an immediate c
+    X86_XOR,
+    X86_CMP,
+    X86_TEST,
+    X86_CQO,
+    X86_IDIV,
+    X86_SETCC,
+    X86_JMP,
+    X86_JCC,
+    X86_PUSH,
+    X86_POP,
+    X86_LEAVE,
+    X86_RET,
+    X86_REP_STOSQ
+};
+
+struct X86Instr
+{
+    X86Opcode opcode;
+    X86Condition condition; // of SETcc and Jcc
+    X86Operand a, b, c;
+};
+
+struct X86Function
+{
+    SymbolId name;
+    uint32_t number;           // of its return label; main is 0
+    vector<X86Instr> prologue; // runs before code; written once the frame size is known
+    vector<X86Instr> code;
+};
+
+struct X86Program
+{
+    vector<X86Function> functions;       // inner functions before the ones they are defined in
+    vector<SymbolId> strings;            // per string literal number
+    vector<vector<uint32_t>> jumpTables; // per table number: the IR label of each entry
+};
+
+class X86CodeGenerator : public InstructionSelector
+{
+public:
+    // The allocation may only use registers from RegisterFile::x86_64(); one made
+    // from an empty register file keeps every temporary in a stack slot.
+    X86Program generate(const vector<IrInstr> &ir, const RegisterAllocation &registerAllocation)
+    {
+        allocation = &registerAllocation;
+        registerOf.clear();
+        for (SymbolId reg : RegisterFile::x86_64().registers)
+        {
+            if (reg >= registerOf.size())
+                registerOf.resize(reg + 1, X86_REGISTER_COUNT);
+            registerOf[reg] = registerNumber(symbols.name(reg));
+        }
+        for (Operand location : allocation->location)
+            if (location.kind == OP_REG && (location.id >= registerOf.size() || registerOf[location.id] == X86_REGISTER_COUNT))
+                throw runtime_error("Register " + operandText(location) + " is reserved by the x86-64 backend");
+        program = X86Program();
+        frames.clear();
+        stringNumbers.clear();
+        variableSlots.clear();
+        defined.clear();
+        functionCount = 0;
+        countTempUses(ir);
+
+        openFunction(symbols.intern("main"));
+        frames.back().function.code.reserve(2 * ir.size());
+        for (size_t i = 0; i < ir.size(); i++)
+        {
+            const IrInstr &instr = ir[i];
+            try
+            {
+                if (!lowerJumpTable(ir, i))
+                    lower(fuseBranch(ir, i));
+            }
+            catch (const runtime_error &e)
+            {
+                cerr << "Error translating instruction: \"" << irText(instr) << "\"\n"
+                     << e.what() << endl;
+                throw; // Rethrow the exception after logging
+            }
+        }
+        while (!frames.empty())
+            closeFunction();
+        return move(program);
+    }
+
+    // RAX for "rax" and so on; X86_REGISTER_COUNT for anything else
+    static X86Register registerNumber(string_view name)
+    {
+        static const char *const names[] = {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+                                            "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"};
+        for (uint8_t r = 0; r < X86_REGISTER_COUNT; r++)
+            if (name == names[r])
+                return X86Register(r);
+        return X86_REGISTER_COUNT;
+    }
+
+private:
+    static constexpr uint32_t NoIndex = 0xFFFFFFFFu;
+
+    struct VariableSlot
+    {
+        uint32_t function = NoIndex, index = 0;
+    };
+
+    struct Frame
+    {
+        X86Function function;
+        uint32_t variables = 0;
+        uint16_t saved = 0;                            // bit per callee-saved register used
+        vector<pair<SymbolId, VariableSlot>> shadowed; // enclosing functions' slots to restore
+    };
+
+    const RegisterAllocation *allocation = nullptr;
+    vector<uint8_t> registerOf; // per symbol: the register it names, or X86_REGISTER_COUNT
+    X86Program program;
+    vector<Frame> frames; // functions being lowered, innermost last
+    vector<SymbolId> defined;
+    vector<VariableSlot> variableSlots; // per symbol, in the innermost function using it
+    vector<uint32_t> stringNumbers;     // per symbol; NoIndex if the string is not in .rodata yet
+    uint32_t functionCount = 0;
+
+    static bool isCalleeSaved(uint8_t reg)
+    {
+        return reg == RBX || reg >= R12;
+    }
+
+    void openFunction(SymbolId name)
+    {
+        if (find(defined.begin(), defined.end(), name) != defined.end() || symbols.name(name) == "_start")
+            throw runtime_error("Function name " + string(symbols.name(name)) + " is already defined");
+        defined.push_back(name);
+        frames.push_back(Frame());
+        frames.back().function.name = name;
+        frames.back().function.number = functionCount++;
+    }
+
+    static void add(vector<X86Instr> &code, X86Opcode opcode, X86Operand a = X86Operand(), X86Operand b = X86Operand())
+    {
+        code.push_back({opcode, CC_E, a, b, X86Operand()});
+    }
+
+    // Gives the innermost function its prologue and epilogue now that its frame size
+    // and registers are known
+    void closeFunction()
+    {
+        Frame &frame = frames.back();
+        vector<X86Instr> &code = frame.function.prologue, &body = frame.function.code;
+        uint32_t slots = allocation->stackSlots + frame.variables;
+        int pushed = __builtin_popcount(frame.saved);
+        int64_t bytes = 8 * int64_t(slots);
+        if ((bytes + 8 * pushed) % 16 != 0) // keep rsp 16-byte aligned
+            bytes += 8;
+
+        add(code, X86_PUSH, x86Register(RBP));
+        add(code, X86_MOV, x86Register(RBP), x86Register(RSP));
+        if (bytes > 0)
+            add(code, X86_SUB, x86Register(RSP), x86Operand(X86Operand::IMMEDIATE, bytes));
+        for (uint8_t r = 0; r < X86_REGISTER_COUNT; r++)
+            if (frame.saved >> r & 1)
+                add(code, X86_PUSH, x86Register(r));
+        if (frame.variables > 4)
+        {
+            add(code, X86_LEA, x86Register(RDI), x86Operand(X86Operand::FRAME_SLOT, -8 * int64_t(slots)));
+            add(code, X86_MOV, x86Register(RCX, 4), x86Operand(X86Operand::IMMEDIATE, frame.variables));
+            add(code, X86_XOR, x86Register(RAX, 4), x86Register(RAX, 4));
+            add(code, X86_REP_STOSQ);
+        }
+        else
+            for (uint32_t v = 0; v < frame.variables; v++)
+                add(code, X86_MOV, frameSlot(allocation->stackSlots + v), x86Operand(X86Operand::IMMEDIATE, 0));
+
+        // A return at the very end falls into the epilogue; otherwise falling off the end returns 0
+        X86Operand epilogue = x86Operand(X86Operand::RETURN_LABEL, frame.function.number);
+        bool returns = !body.empty() && body.back().opcode == X86_JMP && body.back().a == epilogue;
+        if (returns)
+            body.pop_back();
+        else
+            add(body, X86_XOR, x86Register(RAX, 4), x86Register(RAX, 4));
+        add(body, X86_LABEL, epilogue);
+        for (uint8_t r = X86_REGISTER_COUNT; r-- > 0;)
+            if (frame.saved >> r & 1)
+                add(body, X86_POP, x86Register(r));
+        add(body, X86_LEAVE);
+        add(body, X86_RET);
+
+        for (size_t k = frame.shadowed.size(); k-- > 0;)
+            variableSlots[frame.shadowed[k].first] = frame.shadowed[k].second;
+        program.functions.push_back(move(frame.function));
+        frames.pop_back();
+    }
+
+    static X86Operand frameSlot(uint32_t slot)
+    {
+        return x86Operand(X86Operand::FRAME_SLOT, -8 * (int64_t(slot) + 1));
+    }
+
+    static int64_t constantValue(SymbolId symbol)
+    {
+        string_view name = symbols.name(symbol);
+        if (name == "true" || name == "false")
+            return name == "true";
+        int64_t value;
+        if (!caseValue(symbol, value))
+            throw runtime_error("Constant " + string(name) + " does not fit in 64 bits");
+        return value;
+    }
+
+    // Fits the sign-extended 32-bit immediate of most instructions; only mov takes wider ones
+    static bool isImmediate32(const X86Operand &operand)
+    {
+        return operand.kind == X86Operand::IMMEDIATE && operand.value >= INT32_MIN && operand.value <= INT32_MAX;
+    }
+
+    // Where the operand lives after allocation: a register, a frame slot, an immediate or a string
+    X86Operand place(Operand operand)
+    {
+        operand = allocation->locate(operand);
+        Frame &frame = frames.back();
+        switch (operand.kind)
+        {
+        case OP_REG:
+        {
+            uint8_t reg = registerOf[operand.id];
+            if (isCalleeSaved(reg))
+                frame.saved |= uint16_t(1) << reg;
+            return x86Register(reg);
+        }
+        case OP_SLOT:
+            return frameSlot(operand.id);
+        case OP_VAR:
+        {
+            if (operand.id >= variableSlots.size())
+                variableSlots.resize(operand.id + 1);
+            VariableSlot &slot = variableSlots[operand.id];
+            if (slot.function != frame.function.number)
+            {
+                frame.shadowed.push_back({operand.id, slot});
+                slot = {frame.function.number, frame.variables++};
+            }
+            return frameSlot(allocation->stackSlots + slot.index);
+        }
+        case OP_CONST:
+            return x86Operand(X86Operand::IMMEDIATE, constantValue(operand.id));
+        case OP_STRING:
+            if (operand.id >= stringNumbers.size())
+                stringNumbers.resize(operand.id + 1, NoIndex);
+            if (stringNumbers[operand.id] == NoIndex)
+            {
+                stringNumbers[operand.id] = program.strings.size();
+                program.strings.push_back(operand.id);
+            }
+            return x86Operand(X86Operand::STRING, stringNumbers[operand.id]);
+        default:
+            throw runtime_error("Operand " + operandText(operand) + " has no x86-64 location");
+        }
+    }
+
+    void emit(X86Opcode opcode, X86Operand a = X86Operand(), X86Operand b = X86Operand(), X86Operand c = X86Operand())
+    {
+        frames.back().function.code.push_back({opcode, CC_E, a, b, c});
+    }
+
+    void emit(X86Opcode opcode, X86Condition condition, X86Operand a)
+    {
+        frames.back().function.code.push_back({opcode, condition, a, X86Operand(), X86Operand()});
+    }
+
+    // Puts a value in reg, unless it is already there
+    void load(uint8_t reg, X86Operand value)
+    {
+        if (value.kind == X86Operand::STRING)
+            emit(X86_LEA, x86Register(reg), value);
+        else if (value.kind == X86Operand::IMMEDIATE && value.value == 0)
+            emit(X86_XOR, x86Register(reg, 4), x86Register(reg, 4));
+        else if (value.kind == X86Operand::IMMEDIATE && value.value > 0 && value.value <= UINT32_MAX)
+            emit(X86_MOV, x86Register(reg, 4), value); // writing the low half clears the rest
+        else if (value != x86Register(reg))
+            emit(X86_MOV, x86Register(reg), value);
+    }
+
+    // The value as the source of an instruction on a register: loaded into r11 if
+    // no instruction but mov or lea can encode it
+    X86Operand source(X86Operand value)
+    {
+        if (value.kind == X86Operand::STRING || (value.kind == X86Operand::IMMEDIATE && !isImmediate32(value)))
+        {
+            load(R11, value);
+            return x86Register(R11);
+        }
+        return value;
+    }
+
+    // Writes the value of reg to the destination
+    void store(X86Operand destination, uint8_t reg)
+    {
+        if (destination != x86Register(reg))
+            emit(X86_MOV, destination, x86Register(reg));
+    }
+
+    void copy(Operand destination, Operand value)
+    {
+        if (allocation->locate(destination) == allocation->locate(value))
+            return; // coalesced
+        X86Operand target = place(destination), from = place(value);
+        if (target.kind == X86Operand::REGISTER)
+            load(target.reg, from);
+        else if (from.kind == X86Operand::REGISTER || isImmediate32(from))
+            emit(X86_MOV, target, from);
+        else
+        {
+            load(R11, from);
+            store(target, R11);
+        }
+    }
+
+    void arithmetic(const IrInstr &instr)
+    {
+        X86Operand destination = place(instr.dest()), a = place(instr.left()), b = place(instr.right());
+        if (instr.opcode == IR_ADD && (a.kind == X86Operand::STRING || b.kind == X86Operand::STRING))
+            throw runtime_error("String concatenation has no x86-64 lowering");
+        if (instr.opcode == IR_DIV)
+        {
+            load(RAX, a);
+            emit(X86_CQO);
+            if (b.kind == X86Operand::REGISTER || b.kind == X86Operand::FRAME_SLOT)
+                emit(X86_IDIV, b);
+            else
+            {
+                load(R11, b); // idiv takes no immediate
+                emit(X86_IDIV, x86Register(R11));
+            }
+            store(destination, RAX);
+            return;
+        }
+
+        if (instr.opcode != IR_SUB && destination == b && destination != a)
+            swap(a, b);
+        uint8_t work = destination.kind == X86Operand::REGISTER && destination != b ? destination.reg : uint8_t(RAX);
+        load(work, a);
+        if (instr.opcode == IR_MUL && isImmediate32(b))
+            emit(X86_IMUL, x86Register(work), x86Register(work), b);
+        else
+            emit(instr.opcode == IR_ADD ? X86_ADD : instr.opcode == IR_SUB ? X86_SUB : X86_IMUL, x86Register(work), source(b));
+        store(destination, work);
+    }
+
+    // Sets the flags as cmp a, b would
+    void compare(X86Operand a, X86Operand b)
+    {
+        if (a.kind != X86Operand::REGISTER && (a.kind != X86Operand::FRAME_SLOT || b.kind == X86Operand::FRAME_SLOT))
+        {
+            load(RAX, a);
+            a = x86Register(RAX);
+        }
+        if (a.kind == X86Operand::REGISTER && b.kind == X86Operand::IMMEDIATE && b.value == 0)
+            emit(X86_TEST, a, a);
+        else
+            emit(X86_CMP, a, source(b));
+    }
+
+    // Dense switch dispatch: one unsigned bounds check and an indirect jump through
+    // a table of 32-bit offsets in .rodata
+    bool lowerJumpTable(const vector<IrInstr> &ir, size_t &i)
+    {
+        JumpTable jumpTable;
+        if (!findJumpTable(ir, i, jumpTable))
+            return false;
+        load(RAX, place(jumpTable.selector));
+        if (jumpTable.low != 0)
+            emit(X86_SUB, x86Register(RAX), source(x86Operand(X86Operand::IMMEDIATE, jumpTable.low)));
+        emit(X86_CMP, x86Register(RAX), x86Operand(X86Operand::IMMEDIATE, int64_t(table.size()) - 1));
+        emit(X86_JCC, CC_A, x86Operand(X86Operand::LABEL, jumpTable.defaultLabel.id));
+        int64_t number = program.jumpTables.size();
+        emit(X86_LEA, x86Register(R11), x86Operand(X86Operand::TABLE, number));
+        emit(X86_MOVSXD, x86Register(RAX), x86Operand(X86Operand::TABLE_ENTRY, number));
+        emit(X86_ADD, x86Register(RAX), x86Register(R11));
+        emit(X86_JMP, x86Register(RAX));
+        program.jumpTables.emplace_back();
+        for (Operand entry : table)
+            program.jumpTables.back().push_back(entry.id);
+        i = jumpTable.last;
+        return true;
+    }
+
+    void lower(const IrInstr &instr)
+    {
+        static const X86Condition conditions[] = {CC_E, CC_NE, CC_L, CC_G, CC_LE, CC_GE};
+        switch (instr.opcode)
+        {
+        case IR_COPY:
+            copy(instr.dest(), instr.left());
+            break;
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_DIV:
+            arithmetic(instr);
+            break;
+        case IR_EQ:
+        case IR_NE:
+        case IR_LT:
+        case IR_GT:
+        case IR_LE:
+        case IR_GE:
+        {
+            compare(place(instr.left()), place(instr.right()));
+            emit(X86_SETCC, conditions[instr.opcode - IR_EQ], x86Register(RAX, 1));
+            X86Operand destination = place(instr.dest());
+            if (destination.kind == X86Operand::REGISTER)
+                emit(X86_MOVZX, x86Register(destination.reg, 4), x86Register(RAX, 1));
+            else
+            {
+                emit(X86_MOVZX, x86Register(RAX, 4), x86Register(RAX, 1));
+                store(destination, RAX);
+            }
+            break;
+        }
+        case IR_LABEL:
+            emit(X86_LABEL, x86Operand(X86Operand::LABEL, instr.a));
+            break;
+        case IR_JUMP:
+            emit(X86_JMP, x86Operand(X86Operand::LABEL, instr.a));
+            break;
+        case IR_BRANCH:
+        {
+            X86Operand value = place(instr.left());
+            if (value.kind == X86Operand::STRING || (value.kind == X86Operand::IMMEDIATE && value.value != 0))
+                emit(X86_JMP, x86Operand(X86Operand::LABEL, instr.dst));
+            else if (value.kind != X86Operand::IMMEDIATE)
+            {
+                compare(value, x86Operand(X86Operand::IMMEDIATE, 0));
+                emit(X86_JCC, CC_NE, x86Operand(X86Operand::LABEL, instr.dst));
+            }
+            break;
+        }
+        case IR_BRANCH_EQ:
+        case IR_BRANCH_NE:
+        case IR_BRANCH_LT:
+        case IR_BRANCH_GT:
+        case IR_BRANCH_LE:
+        case IR_BRANCH_GE:
+            compare(place(instr.left()), place(instr.right()));
+            emit(X86_JCC, conditions[instr.opcode - IR_BRANCH_EQ], x86Operand(X86Operand::LABEL, instr.dst));
+            break;
+        case IR_RETURN:
+            load(RAX, place(instr.left()));
+            emit(X86_JMP, x86Operand(X86Operand::RETURN_LABEL, frames.back().function.number));
+            break;
+        case IR_FUNC:
+            openFunction(instr.a);
+            break;
+        case IR_END_FUNC:
+            if (frames.size() < 2)
+                throw runtime_error("END FUNC outside a function");
+            closeFunction();
+            break;
+        default:
+            throw runtime_error("Unsupported operation: " + irText(instr));
+        }
+    }
+};
+
+// Prints a lowered program as GNU as source, with a _start that exits with
+// main's return value
+class X86AssemblyPrinter
+{
+public:
+    string print(const X86Program &program)
+    {
+        out.clear();
+        out += "\t.intel_syntax noprefix\n\t.text\n\t.globl _start\n_start:\n"
+               "\tcall main\n\tmov edi, eax\n\tmov eax, 60\n\tsyscall\n";
+        for (const X86Function &function : program.functions)
+        {
+            // Quoted, and sized from a local label, so a name like rcx is not read as a register
+            string_view name = symbols.name(function.name);
+            out += "\n\t.globl \"";
+            out += name;
+            out += "\"\n\t.type \"";
+            out += name;
+            out += "\", @function\n\"";
+            out += name;
+            out += "\":\n.Lfunction";
+            putNumber(function.number);
+            out += ":\n";
+            for (const X86Instr &instr : function.prologue)
+                putInstruction(instr);
+            for (const X86Instr &instr : function.code)
+                putInstruction(instr);
+            out += "\t.size \"";
+            out += name;
+            out += "\", .-.Lfunction";
+            putNumber(function.number);
+            out += '\n';
+        }
+
+        if (!program.strings.empty() || !program.jumpTables.empty())
+            out += "\n\t.section .rodata\n";
+        for (size_t s = 0; s < program.strings.size(); s++)
+        {
+            out += ".LS";
+            putNumber(s);
+            out += ":\n\t.string \"";
+            for (unsigned char c : symbols.name(program.strings[s]))
+            {
+                if (c == '"' || c == '\\')
+                    out += '\\';
+                if (c >= ' ' && c < 0x7F)
+                    out += char(c);
+                else
+                {
+                    char octal[4] = {'\\', char('0' + (c >> 6)), char('0' + (c >> 3 & 7)), char('0' + (c & 7))};
+                    out.append(octal, 4);
+                }
+            }
+            out += "\"\n";
+        }
+        for (size_t t = 0; t < program.jumpTables.size(); t++)
+        {
+            out += "\t.p2align 2\n.LT";
+            putNumber(t);
+            out += ":\n";
+            for (uint32_t label : program.jumpTables[t])
+            {
+                out += "\t.long .L";
+                putNumber(label);
+                out += " - .LT";
+                putNumber(t);
+                out += '\n';
+            }
+        }
+        out += "\n\t.section .note.GNU-stack,\"\",@progbits\n";
+        return move(out);
+    }
+
+private:
+    string out;
+
+    void putNumber(int64_t value)
+    {
+        char digits[24];
+        char *end = to_chars(digits, digits + sizeof(digits), value).ptr;
+        out.append(digits, end - digits);
+    }
+
+    void putOperand(const X86Operand &operand)
+    {
+        static const char *const names[][3] = {
+            {"rax", "eax", "al"}, {"rcx", "ecx", "cl"}, {"rdx", "edx", "dl"}, {"rbx", "ebx", "bl"},
+            {"rsp", "esp", "spl"}, {"rbp", "ebp", "bpl"}, {"rsi", "esi", "sil"}, {"rdi", "edi", "dil"},
+            {"r8", "r8d", "r8b"}, {"r9", "r9d", "r9b"}, {"r10", "r10d", "r10b"}, {"r11", "r11d", "r11b"},
+            {"r12", "r12d", "r12b"}, {"r13", "r13d", "r13b"}, {"r14", "r14d", "r14b"}, {"r15", "r15d", "r15b"}};
+        switch (operand.kind)
+        {
+        case X86Operand::REGISTER:
+            out += names[operand.reg][operand.size == 8 ? 0 : operand.size == 4 ? 1 : 2];
+            break;
+        case X86Operand::FRAME_SLOT:
+            out += "qword ptr [rbp - ";
+            putNumber(-operand.value);
+            out += ']';
+            break;
+        case X86Operand::IMMEDIATE:
+            putNumber(operand.value);
+            break;
+        case X86Operand::LABEL:
+            out += ".L";
+            putNumber(operand.value);
+            break;
+        case X86Operand::RETURN_LABEL:
+            out += ".Lreturn";
+            putNumber(operand.value);
+            break;
+        case X86Operand::STRING:
+            out += "[rip + .LS";
+            putNumber(operand.value);
+            out += ']';
+            break;
+        case X86Operand::TABLE:
+            out += "[rip + .LT";
+            putNumber(operand.value);
+            out += ']';
+            break;
+        case X86Operand::TABLE_ENTRY:
+            out += "dword ptr [r11 + rax*4]";
+            break;
+        case X86Operand::NONE:
+            break;
+        }
+    }
+
+    void putInstruction(const X86Instr &instr)
+    {
+        static const char *const mnemonics[] = {"", "mov", "movzx", "movsxd", "lea", "add", "sub", "imul",
+                                                "xor", "cmp", "test", "cqo", "idiv", "set", "jmp", "j",
+                                                "push", "pop", "leave", "ret", "rep stosq"};
+        static const char *const conditions[] = {"o", "no", "b", "ae", "e", "ne", "be", "a",
+                                                 "s", "ns", "p", "np", "l", "ge", "le", "g"};
+        if (instr.opcode == X86_LABEL)
+        {
+            putOperand(instr.a);
+            out += ":\n";
+            return;
+        }
+        out += '\t';
+        out += mnemonics[instr.opcode];
+        if (instr.opcode == X86_SETCC || instr.opcode == X86_JCC)
+            out += conditions[instr.condition];
+        const X86Operand *operands[] = {&instr.a, &instr.b, &instr.c};
+        for (int k = 0; k < 3 && operands[k]->kind != X86Operand::NONE; k++)
+        {
+            out += k == 0 ? " " : ", ";
+            putOperand(*operands[k]);
+        }
+        out += '\n';
+    }
+};
+
+// GNU as source for the IR under an allocation
+inline string x86Assembly(const vector<IrInstr> &ir, const RegisterAllocation &allocation)
+{
+    return X86AssemblyPrinter().print(X86CodeGenerator().generate(ir, allocation));
+}
@@ -0,0 +1,408 @@
+#pragma once
+
+#include <csetjmp>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "X86Backend.h"
+using namespace std;
+
+// In-process execution of the x86-64 backend's output.
+//
+// X86Encoder turns a lowered program into machine code: the functions one after
+// another, then the string literals and the jump tables. Jumps and RIP-relative
+// addresses are encoded with 32-bit displacements and patched once every label is
+// placed. JitCode copies the bytes into pages mapped writable, then makes them
+// read-only and executable before anything runs (W^X), and calls main as an
+// ordinary function returning int64_t.
+
+class X86Encoder
+{
+public:
+    vector<uint8_t> bytes;
+    size_t mainOffset = 0;
+
+    void encode(const X86Program &program)
+    {
+        bytes.clear();
+        fixups.clear();
+        labels.clear();
+        returns.assign(program.functions.size(), NoOffset);
+        strings.assign(program.strings.size(), NoOffset);
+        tables.assign(program.jumpTables.size(), NoOffset);
+        for (const X86Function &function : program.functions)
+        {
+            if (function.number == 0)
+                mainOffset = bytes.size();
+            for (const X86Instr &instr : function.prologue)
+                instruction(instr);
+            for (const X86Instr &instr : function.code)
+                instruction(instr);
+        }
+
+        for (size_t s = 0; s < program.strings.size(); s++)
+        {
+            string_view text = symbols.name(program.strings[s]);
+            strings[s] = bytes.size();
+            bytes.insert(bytes.end(), text.begin(), text.end());
+            bytes.push_back(0);
+        }
+        for (size_t t = 0; t < program.jumpTables.size(); t++)
+        {
+            bytes.resize((bytes.size() + 3) & ~size_t(3), 0);
+            tables[t] = bytes.size();
+            for (uint32_t label : program.jumpTables[t])
+                put32(int32_t(labelOffset(x86Operand(X86Operand::LABEL, label)) - int64_t(tables[t])));
+        }
+
+        // Every displacement is relative to the end of its 4 bytes; nothing follows them
+        for (const Fixup &fixup : fixups)
+        {
+            int32_t displacement = int32_t(int64_t(labelOffset(fixup.target)) - int64_t(fixup.at + 4));
+            memcpy(&bytes[fixup.at], &displacement, 4);
+        }
+    }
+
+private:
+    static constexpr size_t NoOffset = ~size_t(0);
+
+    struct Fixup
+    {
+        size_t at; // of the 32-bit displacement
+        X86Operand target;
+    };
+
+    vector<Fixup> fixups;
+    vector<size_t> labels;  // per IR label
+    vector<size_t> returns; // per function number
+    vector<size_t> strings, tables;
+
+    size_t &labelSlot(const X86Operand &label)
+    {
+        switch (label.kind)
+        {
+        case X86Operand::RETURN_LABEL:
+            return returns[label.value];
+        case X86Operand::STRING:
+            return strings[label.value];
+        case X86Operand::TABLE:
+            return tables[label.value];
+        default:
+            if (size_t(label.value) >= labels.size())
+                labels.resize(label.value + 1, NoOffset);
+            return labels[label.value];
+        }
+    }
+
+    size_t labelOffset(const X86Operand &label)
+    {
+        size_t offset = labelSlot(label);
+        if (offset == NoOffset)
+            throw runtime_error("Label L" + to_string(label.value) + " is never placed");
+        return offset;
+    }
+
+    void put(uint8_t byte)
+    {
+        bytes.push_back(byte);
+    }
+
+    void put32(int32_t value)
+    {
+        uint8_t little[4];
+        memcpy(little, &value, 4);
+        bytes.insert(bytes.end(), little, little + 4);
+    }
+
+    void put64(int64_t value)
+    {
+        uint8_t little[8];
+        memcpy(little, &value, 8);
+        bytes.insert(bytes.end(), little, little + 8);
+    }
+
+    void reference(const X86Operand &target)
+    {
+        fixups.push_back({bytes.size(), target});
+        put32(0);
+    }
+
+    static bool fits8(int64_t value)
+    {
+        return value >= INT8_MIN && value <= INT8_MAX;
+    }
+
+    static bool fits32(int64_t value)
+    {
+        return value >= INT32_MIN && value <= INT32_MAX;
+    }
+
+    // REX prefix for a register in the reg field and a register or memory operand
+    // in r/m; left out when nothing needs it
+    void rex(bool wide, uint8_t reg, const X86Operand &rm)
+    {
+        uint8_t prefix = 0x40 | wide << 3 | (reg >> 3) << 2;
+        if (rm.kind == X86Operand::REGISTER)
+            prefix |= rm.reg >> 3;
+        else if (rm.kind == X86Operand::TABLE_ENTRY)
+            prefix |= 1; // base r11
+        if (prefix != 0x40)
+            put(prefix);
+    }
+
+    // ModRM, SIB and displacement addressing rm, with reg in the reg field
+    void modrm(uint8_t reg, const X86Operand &rm)
+    {
+        reg = (reg & 7) << 3;
+        switch (rm.kind)
+        {
+        case X86Operand::REGISTER:
+            put(0xC0 | reg | (rm.reg & 7));
+            break;
+        case X86Operand::FRAME_SLOT: // [rbp + disp]
+            if (fits8(rm.value))
+            {
+                put(0x45 | reg);
+                put(uint8_t(rm.value));
+            }
+            else
+            {
+                put(0x85 | reg);
+                put32(int32_t(rm.value));
+            }
+            break;
+        case X86Operand::STRING:
+        case X86Operand::TABLE: // [rip + disp]
+            put(0x05 | reg);
+            reference(rm);
+            break;
+        case X86Operand::TABLE_ENTRY: // [r11 + rax*4]
+            put(0x04 | reg);
+            put(0x83);
+            break;
+        default:
+            throw runtime_error("Operand cannot be addressed");
+        }
+    }
+
+    // opcode with a register in reg and a register or memory operand in r/m
+    void emit(bool wide, initializer_list<uint8_t> opcode, uint8_t reg, const X86Operand &rm)
+    {
+        rex(wide, reg, rm);
+        bytes.insert(bytes.end(), opcode);
+        modrm(reg, rm);
+    }
+
+    // add, sub, xor or cmp; extension is the group-1 opcode extension, and
+    // opcode + 1 and opcode + 3 its r/m, reg and reg, r/m forms
+    void arithmetic(uint8_t extension, uint8_t opcode, const X86Instr &instr)
+    {
+        bool wide = instr.a.size == 8;
+        if (instr.b.kind == X86Operand::IMMEDIATE)
+        {
+            emit(wide, {uint8_t(fits8(instr.b.value) ? 0x83 : 0x81)}, extension, instr.a);
+            if (fits8(instr.b.value))
+                put(uint8_t(instr.b.value));
+            else
+                put32(int32_t(instr.b.value));
+        }
+        else if (instr.b.kind == X86Operand::REGISTER)
+            emit(wide, {uint8_t(opcode + 1)}, instr.b.reg, instr.a);
+        else
+            emit(wide, {uint8_t(opcode + 3)}, instr.a.reg, instr.b);
+    }
+
+    void encodeMove(const X86Instr &instr)
+    {
+        const X86Operand &to = instr.a, &from = instr.b;
+        bool wide = to.size == 8;
+        if (from.kind == X86Operand::IMMEDIATE)
+        {
+            if (to.kind == X86Operand::REGISTER && (!wide || !fits32(from.value)))
+            {
+                // mov r32, imm32 or mov r64, imm64
+                if (wide || to.reg >= 8)
+                    put(0x40 | wide << 3 | to.reg >> 3);
+                put(0xB8 + (to.reg & 7));
+                if (wide)
+                    put64(from.value);
+                else
+                    put32(int32_t(from.value));
+            }
+            else
+            {
+                emit(wide, {0xC7}, 0, to);
+                put32(int32_t(from.value));
+            }
+        }
+        else if (from.kind == X86Operand::REGISTER)
+            emit(wide, {0x89}, from.reg, to);
+        else
+            emit(wide, {0x8B}, to.reg, from);
+    }
+
+    void jump(const X86Operand &target, initializer_list<uint8_t> opcode)
+    {
+        bytes.insert(bytes.end(), opcode);
+        reference(target);
+    }
+
+    void instruction(const X86Instr &instr)
+    {
+        switch (instr.opcode)
+        {
+        case X86_LABEL:
+            labelSlot(instr.a) = bytes.size();
+            break;
+        case X86_MOV:
+            encodeMove(instr);
+            break;
+        case X86_MOVZX:
+            // movzx r32, r/m8; the only 8-bit register used is al, which needs no REX prefix
+            emit(false, {0x0F, 0xB6}, instr.a.reg, instr.b);
+            break;
+        case X86_MOVSXD:
+            emit(true, {0x63}, instr.a.reg, instr.b);
+            break;
+        case X86_LEA:
+            emit(true, {0x8D}, instr.a.reg, instr.b);
+            break;
+        case X86_ADD:
+            arithmetic(0, 0x00, instr);
+            break;
+        case X86_SUB:
+            arithmetic(5, 0x28, instr);
+            break;
+        case X86_XOR:
+            arithmetic(6, 0x30, instr);
+            break;
+        case X86_CMP:
+            arithmetic(7, 0x38, instr);
+            break;
+        case X86_IMUL:
+            if (instr.c.kind == X86Operand::IMMEDIATE)
+            {
+                bool short8 = fits8(instr.c.value);
+                emit(true, {uint8_t(short8 ? 0x6B : 0x69)}, instr.a.reg, instr.b);
+                if (short8)
+                    put(uint8_t(instr.c.value));
+                else
+                    put32(int32_t(instr.c.value));
+            }
+            else
+                emit(true, {0x0F, 0xAF}, instr.a.reg, instr.b);
+            break;
+        case X86_TEST:
+            emit(instr.a.size == 8, {0x85}, instr.b.reg, instr.a);
+            break;
+        case X86_CQO:
+            put(0x48);
+            put(0x99);
+            break;
+        case X86_IDIV:
+            emit(true, {0xF7}, 7, instr.a);
+            break;
+        case X86_SETCC:
+            emit(false, {0x0F, uint8_t(0x90 + instr.condition)}, 0, instr.a);
+            break;
+        case X86_JMP:
+            if (instr.a.kind == X86Operand::REGISTER)
+                emit(false, {0xFF}, 4, instr.a);
+            else
+                jump(instr.a, {0xE9});
+            break;
+        case X86_JCC:
+            jump(instr.a, {0x0F, uint8_t(0x80 + instr.condition)});
+            break;
+        case X86_PUSH:
+        case X86_POP:
+            if (instr.a.reg >= 8)
+                put(0x41);
+            put((instr.opcode == X86_PUSH ? 0x50 : 0x58) + (instr.a.reg & 7));
+            break;
+        case X86_LEAVE:
+            put(0xC9);
+            break;
+        case X86_RET:
+            put(0xC3);
+            break;
+        case X86_REP_STOSQ:
+            put(0xF3);
+            put(0x48);
+            put(0xAB);
+            break;
+        }
+    }
+};
+
+// Executable memory holding an encoded program; unmapped when destroyed
+class JitCode
+{
+public:
+    explicit JitCode(const X86Encoder &encoder)
+    {
+        long page = sysconf(_SC_PAGESIZE);
+        size = (max<size_t>(encoder.bytes.size(), 1) + page - 1) / page * page;
+        void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            throw runtime_error("Cannot map memory for the JIT");
+        base = static_cast<uint8_t *>(memory);
+        memcpy(base, encoder.bytes.data(), encoder.bytes.size());
+        if (mprotect(base, size, PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(base, size);
+            throw runtime_error("Cannot make JIT code executable");
+        }
+        entry = base + encoder.mainOffset;
+    }
+
+    JitCode(const JitCode &) = delete;
+    JitCode &operator=(const JitCode &) = delete;
+
+    ~JitCode()
+    {
+        munmap(base, size);
+    }
+
+    // Runs main and returns its return value; a division by zero, or of the
+    // smallest integer by -1, is reported instead of ending the process
+    int64_t run() const
+    {
+        struct sigaction trap = {}, previous;
+        trap.sa_handler = onArithmeticTrap;
+        sigemptyset(&trap.sa_mask);
+        sigaction(SIGFPE, &trap, &previous);
+        int64_t result = 0;
+        bool trapped = sigsetjmp(trapJump(), 1) != 0;
+        if (!trapped)
+            result = reinterpret_cast<int64_t (*)()>(entry)();
+        sigaction(SIGFPE, &previous, nullptr);
+        if (trapped)
+            throw runtime_error("Arithmetic trap: integer division overflow or division by zero");
+        return result;
+    }
+
+private:
+    uint8_t *base = nullptr;
+    size_t size = 0;
+    const uint8_t *entry = nullptr;
+
+    static sigjmp_buf &trapJump()
+    {
+        static thread_local sigjmp_buf jump;
+        return jump;
+    }
+
+    // The compiled code holds nothing that needs unwinding, so leaving it from the
+    // handler is safe
+    static void onArithmeticTrap(int)
+    {
+        siglongjmp(trapJump(), 1);
+    }
+};
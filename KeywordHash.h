@@ -0,0 +1,110 @@
+#pragma once
+
+// Compile-time perfect hash for keyword recognition, shared by the lexers in
+// Parser.cpp and Final Project/Lexer.h.
+//
+// A word is packed from its length and first, second and last characters and
+// hashed with one multiply. The seed and table size are searched at compile time
+// so that no two keywords share a slot. Lookup is a length-mask test, one hash,
+// and at most one string compare.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+using namespace std;
+
+template <typename Value>
+struct KeywordEntry
+{
+    string_view word;
+    Value value;
+};
+
+template <typename Value, size_t N>
+class KeywordTable
+{
+public:
+    static constexpr size_t MaxBits = 10;
+    static constexpr uint8_t EmptySlot = 0xFF;
+    static_assert(N > 0 && N < EmptySlot, "keyword count out of range");
+
+    constexpr KeywordTable(const KeywordEntry<Value> (&entries)[N], Value fallback)
+        : entries{}, keys{}, slots{}, lengthMask(0), seed(0), shift(0), fallback(fallback)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            this->entries[i] = entries[i];
+            keys[i] = pack(entries[i].word);
+            lengthMask |= uint64_t(1) << (entries[i].word.size() & 63);
+        }
+
+        // Smallest table (at least twice the keyword count) and first seed without collisions
+        size_t bits = 1;
+        while ((size_t(1) << bits) < 2 * N)
+            bits++;
+        for (; bits <= MaxBits; bits++)
+        {
+            for (uint32_t attempt = 1; attempt < 4096; attempt++)
+            {
+                uint32_t candidate = (attempt * 0x9E3779B9u) | 1u;
+                if (tryBuild(candidate, uint32_t(32 - bits)))
+                    return;
+            }
+        }
+        throw "no collision-free seed found for the keyword set";
+    }
+
+    constexpr Value lookup(string_view word) const
+    {
+        // Cheap negative answer for lengths no keyword has (covers most identifiers)
+        if (word.size() >= 64 || !((lengthMask >> word.size()) & 1))
+            return fallback;
+        uint32_t key = pack(word);
+        uint8_t index = slots[(key * seed) >> shift];
+        // The packed key already covers the length and three characters, so the
+        // full compare only runs for words that are almost certainly keywords
+        if (index == EmptySlot || keys[index] != key || entries[index].word != word)
+            return fallback;
+        return entries[index].value;
+    }
+
+private:
+    KeywordEntry<Value> entries[N];
+    uint32_t keys[N];
+    array<uint8_t, size_t(1) << MaxBits> slots;
+    uint64_t lengthMask;
+    uint32_t seed;
+    uint32_t shift;
+    Value fallback;
+
+    static constexpr uint32_t pack(string_view word)
+    {
+        return uint32_t((unsigned char)word[0]) |
+               uint32_t((unsigned char)word[word.size() > 1 ? 1 : 0]) << 8 |
+               uint32_t((unsigned char)word[word.size() - 1]) << 16 |
+               uint32_t(word.size()) << 24;
+    }
+
+    constexpr bool tryBuild(uint32_t candidate, uint32_t candidateShift)
+    {
+        for (auto &slot : slots)
+            slot = EmptySlot;
+        for (size_t i = 0; i < N; i++)
+        {
+            uint32_t h = (keys[i] * candidate) >> candidateShift;
+            if (slots[h] != EmptySlot)
+                return false;
+            slots[h] = uint8_t(i);
+        }
+        seed = candidate;
+        shift = candidateShift;
+        return true;
+    }
+};
+
+template <typename Value, size_t N>
+constexpr KeywordTable<Value, N> makeKeywordTable(const KeywordEntry<Value> (&entries)[N], Value fallback)
+{
+    return KeywordTable<Value, N>(entries, fallback);
+}
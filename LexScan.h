@@ -0,0 +1,248 @@
+#pragma once
+
+// Bulk scanning kernels shared by the lexers in Parser.cpp and Final Project/Lexer.h.
+// Each kernel starts at `pos` and returns the index of the first byte that does not
+// belong to the run. The AVX2 and SSE2 versions look at 32 or 16 bytes per step and
+// fall back to the scalar loop for the tail of the buffer.
+
+#include <cstddef>
+#include <cstdint>
+using namespace std;
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define LEXSCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace lexscan
+{
+    inline bool isSpaceByte(unsigned char c) { return c == ' ' || (unsigned char)(c - 9) <= 4; }
+    inline bool isDigitByte(unsigned char c) { return (unsigned char)(c - '0') <= 9; }
+    inline bool isAlphaByte(unsigned char c) { return (unsigned char)((c | 0x20) - 'a') <= 25; }
+
+    // Scalar fallbacks
+    inline size_t skipSpaceScalar(const char *p, size_t pos, size_t end, int &newlines)
+    {
+        while (pos < end && isSpaceByte((unsigned char)p[pos]))
+        {
+            newlines += p[pos] == '\n';
+            pos++;
+        }
+        return pos;
+    }
+
+    template <bool AllowUnderscore>
+    inline size_t skipWordScalar(const char *p, size_t pos, size_t end)
+    {
+        while (pos < end)
+        {
+            unsigned char c = (unsigned char)p[pos];
+            if (!(isAlphaByte(c) || isDigitByte(c) || (AllowUnderscore && c == '_')))
+                break;
+            pos++;
+        }
+        return pos;
+    }
+
+    inline size_t skipDigitsScalar(const char *p, size_t pos, size_t end)
+    {
+        while (pos < end && isDigitByte((unsigned char)p[pos]))
+            pos++;
+        return pos;
+    }
+
+    // Stops at '"', '\\' or '\n', whichever comes first
+    inline size_t findStringStopScalar(const char *p, size_t pos, size_t end)
+    {
+        while (pos < end && p[pos] != '"' && p[pos] != '\\' && p[pos] != '\n')
+            pos++;
+        return pos;
+    }
+
+#ifdef LEXSCAN_X86
+    // Unsigned "x <= limit" for every byte lane
+    __attribute__((target("sse2"))) inline __m128i lanesAtMost(__m128i x, char limit)
+    {
+        return _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(limit)), x);
+    }
+
+    __attribute__((target("sse2"))) inline unsigned spaceMask16(__m128i v)
+    {
+        __m128i ctrl = lanesAtMost(_mm_sub_epi8(v, _mm_set1_epi8(9)), 4);
+        __m128i blank = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+        return (unsigned)_mm_movemask_epi8(_mm_or_si128(ctrl, blank));
+    }
+
+    template <bool AllowUnderscore>
+    __attribute__((target("sse2"))) inline unsigned wordMask16(__m128i v)
+    {
+        __m128i digit = lanesAtMost(_mm_sub_epi8(v, _mm_set1_epi8('0')), 9);
+        __m128i alpha = lanesAtMost(_mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a')), 25);
+        __m128i m = _mm_or_si128(digit, alpha);
+        if (AllowUnderscore)
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+        return (unsigned)_mm_movemask_epi8(m);
+    }
+
+    __attribute__((target("sse2"))) inline size_t skipSpaceSSE2(const char *p, size_t pos, size_t end, int &newlines)
+    {
+        while (pos + 16 <= end)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(p + pos));
+            unsigned stop = ~spaceMask16(v) & 0xFFFFu;
+            unsigned nl = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+            if (stop)
+            {
+                unsigned idx = __builtin_ctz(stop);
+                newlines += __builtin_popcount(nl & ((1u << idx) - 1));
+                return pos + idx;
+            }
+            newlines += __builtin_popcount(nl);
+            pos += 16;
+        }
+        return skipSpaceScalar(p, pos, end, newlines);
+    }
+
+    template <bool AllowUnderscore>
+    __attribute__((target("sse2"))) inline size_t skipWordSSE2(const char *p, size_t pos, size_t end)
+    {
+        while (pos + 16 <= end)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(p + pos));
+            unsigned stop = ~wordMask16<AllowUnderscore>(v) & 0xFFFFu;
+            if (stop)
+                return pos + __builtin_ctz(stop);
+            pos += 16;
+        }
+        return skipWordScalar<AllowUnderscore>(p, pos, end);
+    }
+
+    __attribute__((target("sse2"))) inline size_t skipDigitsSSE2(const char *p, size_t pos, size_t end)
+    {
+        while (pos + 16 <= end)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(p + pos));
+            unsigned stop = ~(unsigned)_mm_movemask_epi8(lanesAtMost(_mm_sub_epi8(v, _mm_set1_epi8('0')), 9)) & 0xFFFFu;
+            if (stop)
+                return pos + __builtin_ctz(stop);
+            pos += 16;
+        }
+        return skipDigitsScalar(p, pos, end);
+    }
+
+    __attribute__((target("sse2"))) inline size_t findStringStopSSE2(const char *p, size_t pos, size_t end)
+    {
+        while (pos + 16 <= end)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(p + pos));
+            __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                     _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\')),
+                                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+            unsigned stop = (unsigned)_mm_movemask_epi8(m);
+            if (stop)
+                return pos + __builtin_ctz(stop);
+            pos += 16;
+        }
+        return findStringStopScalar(p, pos, end);
+    }
+
+    __attribute__((target("avx2"))) inline __m256i lanesAtMost256(__m256i x, char limit)
+    {
+        return _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(limit)), x);
+    }
+
+    __attribute__((target("avx2"))) inline size_t skipSpaceAVX2(const char *p, size_t pos, size_t end, int &newlines)
+    {
+        while (pos + 32 <= end)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(p + pos));
+            __m256i ctrl = lanesAtMost256(_mm256_sub_epi8(v, _mm256_set1_epi8(9)), 4);
+            __m256i blank = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+            uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(ctrl, blank));
+            uint32_t nl = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+            if (stop)
+            {
+                unsigned idx = __builtin_ctz(stop);
+                newlines += __builtin_popcount(nl & (uint32_t)((1ull << idx) - 1));
+                return pos + idx;
+            }
+            newlines += __builtin_popcount(nl);
+            pos += 32;
+        }
+        return skipSpaceSSE2(p, pos, end, newlines);
+    }
+
+    template <bool AllowUnderscore>
+    __attribute__((target("avx2"))) inline size_t skipWordAVX2(const char *p, size_t pos, size_t end)
+    {
+        while (pos + 32 <= end)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(p + pos));
+            __m256i digit = lanesAtMost256(_mm256_sub_epi8(v, _mm256_set1_epi8('0')), 9);
+            __m256i alpha = lanesAtMost256(_mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a')), 25);
+            __m256i m = _mm256_or_si256(digit, alpha);
+            if (AllowUnderscore)
+                m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+            uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(m);
+            if (stop)
+                return pos + __builtin_ctz(stop);
+            pos += 32;
+        }
+        return skipWordSSE2<AllowUnderscore>(p, pos, end);
+    }
+
+    __attribute__((target("avx2"))) inline size_t skipDigitsAVX2(const char *p, size_t pos, size_t end)
+    {
+        while (pos + 32 <= end)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(p + pos));
+            uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(lanesAtMost256(_mm256_sub_epi8(v, _mm256_set1_epi8('0')), 9));
+            if (stop)
+                return pos + __builtin_ctz(stop);
+            pos += 32;
+        }
+        return skipDigitsSSE2(p, pos, end);
+    }
+
+    __attribute__((target("avx2"))) inline size_t findStringStopAVX2(const char *p, size_t pos, size_t end)
+    {
+        while (pos + 32 <= end)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(p + pos));
+            __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                                        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')),
+                                                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))));
+            uint32_t stop = (uint32_t)_mm256_movemask_epi8(m);
+            if (stop)
+                return pos + __builtin_ctz(stop);
+            pos += 32;
+        }
+        return findStringStopSSE2(p, pos, end);
+    }
+#endif
+
+    // Kernel table picked once at startup
+    struct Kernels
+    {
+        const char *name;
+        size_t (*skipSpace)(const char *p, size_t pos, size_t end, int &newlines);
+        size_t (*skipIdentifier)(const char *p, size_t pos, size_t end); // [A-Za-z0-9_]
+        size_t (*skipAlnum)(const char *p, size_t pos, size_t end);      // [A-Za-z0-9]
+        size_t (*skipDigits)(const char *p, size_t pos, size_t end);
+        size_t (*findStringStop)(const char *p, size_t pos, size_t end);
+    };
+
+    inline Kernels selectKernels()
+    {
+#ifdef LEXSCAN_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return Kernels{"avx2", skipSpaceAVX2, skipWordAVX2<true>, skipWordAVX2<false>, skipDigitsAVX2, findStringStopAVX2};
+        if (__builtin_cpu_supports("sse2"))
+            return Kernels{"sse2", skipSpaceSSE2, skipWordSSE2<true>, skipWordSSE2<false>, skipDigitsSSE2, findStringStopSSE2};
+#endif
+        return Kernels{"scalar", skipSpaceScalar, skipWordScalar<true>, skipWordScalar<false>, skipDigitsScalar, findStringStopScalar};
+    }
+
+    inline const Kernels kernels = selectKernels();
+}
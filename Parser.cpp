@@ -3,7 +3,10 @@
 #include <string>
 #include <cctype>
 #include <map>
-#include <fstream>
+#include "LexScan.h"
+#include "SourceBuffer.h"
+#include "KeywordHash.h"
+#include "TokenStream.h"
 
 using namespace std;
 
@@ -34,156 +37,147 @@ enum TokenType
     T_EOF,
 };
 
+// Reserved words, recognised with a compile-time perfect hash
+constexpr auto keywords = makeKeywordTable<TokenType>(
+    {
+        {"int", T_INT},
+        {"float", T_FLOAT},
+        {"double", T_DOUBLE},
+        {"string", T_STRING},
+        {"bool", T_BOOL},
+        {"false", T_BOOL},
+        {"true", T_BOOL},
+        {"char", T_CHAR},
+        {"if", T_IF},
+        {"else", T_ELSE},
+        {"return", T_RETURN},
+    },
+    T_ID);
+
+// Token values are views into the SourceBuffer the lexer ran over
 struct Token
 {
-    TokenType type;
-    string value;
-    int lineNumber;
+    string_view value;
+    TokenType type = T_EOF;
+    int lineNumber = 0;
+
+    Token() = default;
+    Token(TokenType type, string_view value, int lineNumber) : value(value), type(type), lineNumber(lineNumber) {}
 };
 
-class Lexer
+class Lexer : public TokenSource<Token>
 {
 private:
-    string src;
+    string_view src;
     size_t pos;
     int lineNumber;
 
 public:
-    Lexer(const string &src)
+    Lexer(const SourceBuffer &source)
     {
-        this->src = src;
+        this->src = source.text();
         this->pos = 0;
         this->lineNumber = 1;
     }
 
-    vector<Token> tokenize()
+    // Returns the next token, or T_EOF (repeatedly) once the input is exhausted
+    Token nextToken() override
     {
-        vector<Token> tokens;
         while (pos < src.size())
         {
             char current = src[pos];
 
-            if (current == '\n')
-            {
-                lineNumber++;
-                pos++;
-                continue;
-            }
             if (isspace(current))
             {
-                pos++;
+                pos = lexscan::kernels.skipSpace(src.data(), pos, src.size(), lineNumber);
                 continue;
             }
             if (isdigit(current))
             {
-                tokens.push_back(Token{T_NUM, consumeNumber(), lineNumber});
-                continue;
+                return Token{T_NUM, consumeNumber(), lineNumber};
             }
             if (current == '"')
             {
-                tokens.push_back(Token{T_STRING, consumeString(), lineNumber});
-                continue;
+                return Token{T_STRING, consumeString(), lineNumber};
             }
             if (isalpha(current))
             {
-                string word = consumeWord();
-                if (word == "int")
-                    tokens.push_back(Token{T_INT, word, lineNumber});
-                else if (word == "float")
-                    tokens.push_back(Token{T_FLOAT, word, lineNumber});
-                else if (word == "double")
-                    tokens.push_back(Token{T_DOUBLE, word, lineNumber});
-                else if (word == "string")
-                    tokens.push_back(Token{T_STRING, word, lineNumber});
-                else if (word == "bool")
-                    tokens.push_back(Token{T_BOOL, word, lineNumber});
-                else if (word == "false" || word == "true")
-                    tokens.push_back(Token{T_BOOL, word, lineNumber});
-                else if (word == "char")
-                    tokens.push_back(Token{T_CHAR, word, lineNumber});
-                else if (word == "if")
-                    tokens.push_back(Token{T_IF, word, lineNumber});
-                else if (word == "else")
-                    tokens.push_back(Token{T_ELSE, word, lineNumber});
-                else if (word == "return")
-                    tokens.push_back(Token{T_RETURN, word, lineNumber});
-                else
-                    tokens.push_back(Token{T_ID, word, lineNumber});
-
-                continue;
+                string_view word = consumeWord();
+                return Token{keywords.lookup(word), word, lineNumber};
             }
 
+            TokenType type;
             switch (current)
             {
             case '=':
-                tokens.push_back(Token{T_ASSIGN, "=", lineNumber});
+                type = T_ASSIGN;
                 break;
             case '+':
-                tokens.push_back(Token{T_PLUS, "+", lineNumber});
+                type = T_PLUS;
                 break;
             case '-':
-                tokens.push_back(Token{T_MINUS, "-", lineNumber});
+                type = T_MINUS;
                 break;
             case '*':
-                tokens.push_back(Token{T_MUL, "*", lineNumber});
+                type = T_MUL;
                 break;
             case '/':
-                tokens.push_back(Token{T_DIV, "/", lineNumber});
+                type = T_DIV;
                 break;
             case '(':
-                tokens.push_back(Token{T_LPAREN, "(", lineNumber});
+                type = T_LPAREN;
                 break;
             case ')':
-                tokens.push_back(Token{T_RPAREN, ")", lineNumber});
+                type = T_RPAREN;
                 break;
             case '{':
-                tokens.push_back(Token{T_LBRACE, "{", lineNumber});
+                type = T_LBRACE;
                 break;
             case '}':
-                tokens.push_back(Token{T_RBRACE, "}", lineNumber});
+                type = T_RBRACE;
                 break;
             case ';':
-                tokens.push_back(Token{T_SEMICOLON, ";", lineNumber});
+                type = T_SEMICOLON;
                 break;
             case '>':
-                tokens.push_back(Token{T_GT, ">", lineNumber});
+                type = T_GT;
                 break;
             default:
                 cout << "Unexpected character: " << "'" << current << "' at line " << lineNumber << endl;
                 exit(1);
             }
             pos++;
+            return Token{type, src.substr(pos - 1, 1), lineNumber};
         }
-        tokens.push_back(Token{T_EOF, "", lineNumber});
-        return tokens;
+        return Token{T_EOF, "", lineNumber};
     }
 
-    string consumeNumber()
+    string_view consumeNumber()
     {
         size_t start = pos;
-        bool hasDecimal = false;
-        while (pos < src.size() && (isdigit(src[pos]) || (src[pos] == '.' && !hasDecimal)))
+        pos = lexscan::kernels.skipDigits(src.data(), pos, src.size());
+        if (pos < src.size() && src[pos] == '.')
         {
-            if (src[pos] == '.')
-            {
-                hasDecimal = true;
-            }
-            pos++;
+            pos = lexscan::kernels.skipDigits(src.data(), pos + 1, src.size());
         }
         return src.substr(start, pos - start);
     }
-    string consumeString()
+    string_view consumeString()
     {
         size_t start = pos + 1;
         pos++;
         while (pos < src.size() && src[pos] != '"')
         {
-            if (src[pos] == '\n')
+            pos = lexscan::kernels.findStringStop(src.data(), pos, src.size());
+            if (pos < src.size() && src[pos] == '\n')
             {
                 cout << "Unexpected newline in string literal at line " << lineNumber << endl;
                 exit(1);
             }
-            pos++;
+            if (pos < src.size() && src[pos] == '\\')
+            {
+                pos++; // backslashes have no special meaning here
+            }
         }
         if (pos < src.size())
         {
@@ -191,11 +185,10 @@ public:
         }
         return src.substr(start, pos - start - 1);
     }
-    string consumeWord()
+    string_view consumeWord()
     {
         size_t start = pos;
-        while (pos < src.size() && isalnum(src[pos]))
-            pos++;
+        pos = lexscan::kernels.skipAlnum(src.data(), pos, src.size());
         return src.substr(start, pos - start);
     }
 };
@@ -203,15 +196,13 @@ public:
 class Parser
 {
 public:
-    Parser(const vector<Token> &tokens)
+    Parser(TokenStream<Token> &tokens) : tokens(tokens)
     {
-        this->tokens = tokens;
-        this->pos = 0;
     }
 
     void parseProgram()
     {
-        while (tokens[pos].type != T_EOF)
+        while (tokens.peek().type != T_EOF)
         {
             parseStatement();
         }
@@ -219,47 +210,46 @@ public:
     }
 
 private:
-    vector<Token> tokens;
-    size_t pos;
+    TokenStream<Token> &tokens; // pulled from the lexer as parsing proceeds
 
     void error(const string &message)
     {
-        cout << "Syntax error at line " << tokens[pos].lineNumber << ": " << message << endl;
+        cout << "Syntax error at line " << tokens.peek().lineNumber << ": " << message << endl;
         exit(1);
     }
 
     void parseStatement()
     {
-        if (tokens[pos].type == T_INT || tokens[pos].type == T_FLOAT || tokens[pos].type == T_DOUBLE || tokens[pos].type == T_STRING || tokens[pos].type == T_BOOL || tokens[pos].type == T_CHAR)
+        if (tokens.peek().type == T_INT || tokens.peek().type == T_FLOAT || tokens.peek().type == T_DOUBLE || tokens.peek().type == T_STRING || tokens.peek().type == T_BOOL || tokens.peek().type == T_CHAR)
         {
-            parseDeclaration(tokens[pos].type);
+            parseDeclaration(tokens.peek().type);
         }
-        else if (tokens[pos].type == T_ID)
+        else if (tokens.peek().type == T_ID)
         {
             parseAssignment();
         }
-        else if (tokens[pos].type == T_IF)
+        else if (tokens.peek().type == T_IF)
         {
             parseIfStatement();
         }
-        else if (tokens[pos].type == T_RETURN)
+        else if (tokens.peek().type == T_RETURN)
         {
             parseReturnStatement();
         }
-        else if (tokens[pos].type == T_LBRACE)
+        else if (tokens.peek().type == T_LBRACE)
         {
             parseBlock();
         }
         else
         {
-            error("unexpected token " + tokens[pos].value);
+            error("unexpected token " + string(tokens.peek().value));
         }
     }
 
     void parseBlock()
     {
         expect(T_LBRACE);
-        while (tokens[pos].type != T_RBRACE && tokens[pos].type != T_EOF)
+        while (tokens.peek().type != T_RBRACE && tokens.peek().type != T_EOF)
         {
             parseStatement();
         }
@@ -288,7 +278,7 @@ private:
         parseExpression();
         expect(T_RPAREN);
         parseStatement();
-        if (tokens[pos].type == T_ELSE)
+        if (tokens.peek().type == T_ELSE)
         {
             expect(T_ELSE);
             parseStatement();
@@ -305,14 +295,14 @@ private:
     void parseExpression()
     {
         parseTerm();
-        while (tokens[pos].type == T_PLUS || tokens[pos].type == T_MINUS)
+        while (tokens.peek().type == T_PLUS || tokens.peek().type == T_MINUS)
         {
-            pos++;
+            tokens.advance();
             parseTerm();
         }
-        if (tokens[pos].type == T_GT)
+        if (tokens.peek().type == T_GT)
         {
-            pos++;
+            tokens.advance();
             parseExpression(); // After relational operator, parse the next expression
         }
     }
@@ -320,25 +310,25 @@ private:
     void parseTerm()
     {
         parseFactor();
-        while (tokens[pos].type == T_MUL || tokens[pos].type == T_DIV)
+        while (tokens.peek().type == T_MUL || tokens.peek().type == T_DIV)
         {
-            pos++;
+            tokens.advance();
             parseFactor();
         }
     }
 
     void parseFactor()
     {
-        if (tokens[pos].type == T_NUM || tokens[pos].type == T_ID)
+        if (tokens.peek().type == T_NUM || tokens.peek().type == T_ID)
         {
-            pos++;
+            tokens.advance();
         }
-        else if (tokens[pos].type == T_BOOL)
+        else if (tokens.peek().type == T_BOOL)
         {
 
-            pos++;
+            tokens.advance();
         }
-        else if (tokens[pos].type == T_LPAREN)
+        else if (tokens.peek().type == T_LPAREN)
         {
             expect(T_LPAREN);
             parseExpression();
@@ -346,19 +336,19 @@ private:
         }
         else
         {
-            error("unexpected token " + tokens[pos].value);
+            error("unexpected token " + string(tokens.peek().value));
         }
     }
 
     void expect(TokenType type)
     {
-        if (tokens[pos].type == type)
+        if (tokens.peek().type == type)
         {
-            pos++;
+            tokens.advance();
         }
         else
         {
-            error("expected " + tokenTypeToString(type) + " but found " + tokens[pos].value);
+            error("expected " + tokenTypeToString(type) + " but found " + string(tokens.peek().value));
         }
     }
 
@@ -410,31 +400,24 @@ private:
 
 int main(int argc, char *argv[])
 {
-    if (argc != 2)
+    // --populate prefaults the whole mapping instead of paging it in while lexing
+    bool populate = argc == 3 && string(argv[1]) == "--populate";
+    if (argc != 2 && !populate)
     {
-        std::cerr << "Usage: " << argv[0] << " <file_name>\n";
+        std::cerr << "Usage: " << argv[0] << " [--populate] <file_name | ->\n";
         return 1;
     }
+    const char *path = argv[argc - 1];
 
-    ifstream file(argv[1]);
-
-    if (!file.is_open())
+    SourceBuffer source;
+    if (!source.loadFile(path, populate))
     {
-        std::cerr << "Error: Could not open file " << argv[1] << "\n";
+        std::cerr << "Error: Could not open file " << path << "\n";
         return 1;
     }
 
-    string line;
-    string content;
-    while (getline(file, line))
-    {
-        content += line + "\n";
-    }
-
-    file.close();
-
-    Lexer lexer(content);
-    vector<Token> tokens = lexer.tokenize();
+    Lexer lexer(source);
+    TokenStream<Token> tokens(lexer);
 
     Parser parser(tokens);
     parser.parseProgram();
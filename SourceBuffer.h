@@ -0,0 +1,153 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <mutex>
+#ifdef _WIN32
+#include <fstream>
+#include <iostream>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+// Owns the program text for the whole compilation. Tokens hold string_views into
+// it, so no per-token copies are made. String literals that needed escape decoding
+// are the only lexemes that do not exist verbatim in the source; their decoded
+// form is stored here as well so their views stay valid just as long.
+//
+// Files are memory-mapped read-only where possible; pipes and stdin are read into
+// an owned string.
+class SourceBuffer
+{
+public:
+    SourceBuffer() = default;
+    explicit SourceBuffer(string text) : contents(std::move(text)), view(contents) {}
+
+    SourceBuffer(const SourceBuffer &) = delete;
+    SourceBuffer &operator=(const SourceBuffer &) = delete;
+
+    ~SourceBuffer()
+    {
+        unmap();
+    }
+
+    // Loads `path` ("-" for stdin). With `populate`, the whole mapping is faulted
+    // in up front (MAP_POPULATE) instead of page by page while lexing.
+    bool loadFile(const string &path, bool populate = false)
+    {
+        unmap();
+        contents.clear();
+        view = string_view();
+#ifdef _WIN32
+        (void)populate;
+        if (path == "-")
+        {
+            contents.assign(istreambuf_iterator<char>(cin), istreambuf_iterator<char>());
+            view = contents;
+            return true;
+        }
+        ifstream file(path, ios::binary | ios::ate);
+        if (!file.is_open())
+            return false;
+        contents.resize((size_t)file.tellg());
+        file.seekg(0);
+        file.read(&contents[0], contents.size());
+        view = contents;
+        return true;
+#else
+        int fd = path == "-" ? STDIN_FILENO : open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        bool regular = fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+        if (regular && info.st_size > 0)
+        {
+            int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+            if (populate)
+                flags |= MAP_POPULATE;
+#endif
+            void *address = mmap(nullptr, (size_t)info.st_size, PROT_READ, flags, fd, 0);
+            if (address != MAP_FAILED)
+            {
+                madvise(address, (size_t)info.st_size, MADV_SEQUENTIAL);
+                mapping = address;
+                mappingSize = (size_t)info.st_size;
+                view = string_view((const char *)address, mappingSize);
+                if (fd != STDIN_FILENO)
+                    close(fd);
+                return true;
+            }
+        }
+
+        // Pipes, stdin and files that cannot be mapped: read() straight into one buffer
+        bool ok = readAll(fd, regular ? (size_t)info.st_size : 0);
+        if (fd != STDIN_FILENO)
+            close(fd);
+        view = contents;
+        return ok;
+#endif
+    }
+
+    string_view text() const
+    {
+        return view;
+    }
+
+    // Keeps a decoded lexeme alive and returns a view of it. Safe to call from
+    // several lexer threads at once.
+    string_view storeDecoded(string value)
+    {
+        lock_guard<mutex> lock(decodedMutex);
+        decoded.push_back(std::move(value));
+        return decoded.back();
+    }
+
+private:
+    string contents;       // owned text when the source is not mapped
+    string_view view;      // the program text, mapped or owned
+    deque<string> decoded; // deque never relocates existing elements
+    mutex decodedMutex;
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+
+    void unmap()
+    {
+#ifndef _WIN32
+        if (mapping)
+            munmap(mapping, mappingSize);
+#endif
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+
+#ifndef _WIN32
+    bool readAll(int fd, size_t sizeHint)
+    {
+        contents.resize(sizeHint > 0 ? sizeHint + 1 : 1 << 16); // +1 so EOF is seen without regrowing
+        size_t used = 0;
+        while (true)
+        {
+            if (used == contents.size())
+                contents.resize(contents.size() * 2);
+            ssize_t n = read(fd, &contents[used], contents.size() - used);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                return false;
+            if (n == 0)
+                break;
+            used += (size_t)n;
+        }
+        contents.resize(used);
+        return true;
+    }
+#endif
+};
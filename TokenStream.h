@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+// Anything that hands out tokens one at a time. After the end of input it must
+// keep returning the end-of-file token.
+template <typename TokenT>
+class TokenSource
+{
+public:
+    virtual ~TokenSource() = default;
+    virtual TokenT nextToken() = 0;
+};
+
+// Replays a token list that was lexed up front. The list must end with the
+// end-of-file token.
+template <typename TokenT>
+class TokenListSource : public TokenSource<TokenT>
+{
+public:
+    explicit TokenListSource(const vector<TokenT> &tokens) : tokens(tokens), index(0) {}
+
+    TokenT nextToken() override
+    {
+        return index + 1 < tokens.size() ? tokens[index++] : tokens.back();
+    }
+
+private:
+    const vector<TokenT> &tokens;
+    size_t index;
+};
+
+// Pull-based token stream with bounded lookahead. Tokens are requested from the
+// source only when the parser looks at them and are kept in a small ring buffer,
+// so the memory held for tokens is O(Lookahead) instead of O(file).
+template <typename TokenT, size_t Lookahead = 4>
+class TokenStream
+{
+public:
+    explicit TokenStream(TokenSource<TokenT> &source) : source(source), head(0), count(0) {}
+
+    // Token k positions ahead of the current one (k < Lookahead)
+    const TokenT &peek(size_t k = 0)
+    {
+        assert(k < Lookahead);
+        while (count <= k)
+        {
+            buffer[(head + count) & Mask] = source.nextToken();
+            count++;
+        }
+        return buffer[(head + k) & Mask];
+    }
+
+    // Consumes and returns the current token
+    TokenT next()
+    {
+        TokenT token = peek();
+        advance();
+        return token;
+    }
+
+    void advance()
+    {
+        peek();
+        head = (head + 1) & Mask;
+        count--;
+    }
+
+private:
+    static constexpr size_t capacityFor(size_t n)
+    {
+        size_t c = 1;
+        while (c < n)
+            c <<= 1;
+        return c;
+    }
+    static constexpr size_t Capacity = capacityFor(Lookahead);
+    static constexpr size_t Mask = Capacity - 1;
+
+    TokenSource<TokenT> &source;
+    array<TokenT, Capacity> buffer;
+    size_t head;
+    size_t count;
+};